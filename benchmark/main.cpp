@@ -43,6 +43,14 @@ static void merge_sort(RandomIt first, RandomIt last) noexcept
     std::inplace_merge(first, mid, last);
 }
 
+// Keeps buffers between runs
+template<class RandomIt>
+static void patience_sorter(RandomIt first, RandomIt last)
+{
+    static Patience::Sorter<typename RandomIt::value_type> sorter;
+    sorter.sort(first, last);
+}
+
 template<typename Container>
 static auto shuffle(Container* c, int seed)
 {
@@ -77,6 +85,46 @@ static void sorting(benchmark::State& state)
     state.SetComplexityN(state.range(0));
 }
 
+// Sorted data with local jitter, like an append-ordered log
+template<template<typename> typename Container, SortingFunction<typename Container<int>::iterator> func>
+static void nearly_sorting(benchmark::State& state)
+{
+    Container<int> data(state.range(0));
+
+    for (auto _ : state) {
+        {
+            Pause p(state);
+            std::iota(data.begin(), data.end(), 0);
+            for (std::size_t i = 0; i + 3 < data.size(); i += 16)
+                std::swap(data[i], data[i + 3]);
+        }
+        func(data.begin(), data.end());
+    }
+
+    state.SetComplexityN(state.range(0));
+}
+
+// Interleaves increasing sequences, so dealing makes about state.range(0) decks
+template<template<typename, typename> typename Tops>
+static void dealing(benchmark::State& state)
+{
+    const int size = 1 << 16;
+    std::vector<int> data(size);
+    std::vector<int> tops(state.range(0));
+    std::mt19937 gen(0);
+
+    for (auto _ : state) {
+        {
+            Pause p(state);
+            for (std::size_t i = 0; i < tops.size(); ++i)
+                tops[i] = i * size;
+            for (auto& x : data)
+                x = tops[gen() % tops.size()]++;
+        }
+        benchmark::DoNotOptimize(Patience::install<std::deque<int>, Tops>(data.begin(), data.end(), std::less<int>()));
+    }
+}
+
 template<ListSortingFunction func>
 static void list_sorting(benchmark::State& state)
 {
@@ -111,10 +159,25 @@ static void list_qsort(std::list<int>& list)
 template<typename T> using Vector = std::vector<T>;
 
 BENCHMARK_TEMPLATE(sorting, Vector, patience_sort_cont)->RangeMultiplier(2)->Range(1, 1 << 18)->Complexity(benchmark::oNLogN);
+BENCHMARK_TEMPLATE(sorting, Vector, patience_sort_cont<Patience::EytzingerTops>)->RangeMultiplier(2)->Range(1, 1 << 18)->Complexity(benchmark::oNLogN);
+BENCHMARK_TEMPLATE(sorting, Vector, patience_sort_arena)->RangeMultiplier(2)->Range(1, 1 << 18)->Complexity(benchmark::oNLogN);
+BENCHMARK_TEMPLATE(sorting, Vector, patience_sort_scatter)->RangeMultiplier(2)->Range(1, 1 << 18)->Complexity(benchmark::oNLogN);
+BENCHMARK_TEMPLATE(sorting, Vector, patience_sort_kway)->RangeMultiplier(2)->Range(1, 1 << 18)->Complexity(benchmark::oNLogN);
+BENCHMARK_TEMPLATE(sorting, Vector, patience_sort_parallel)->RangeMultiplier(2)->Range(1, 1 << 18)->Complexity(benchmark::oNLogN);
+BENCHMARK_TEMPLATE(sorting, Vector, patience_sort_tasks)->RangeMultiplier(2)->Range(1, 1 << 18)->Complexity(benchmark::oNLogN);
+BENCHMARK_TEMPLATE(sorting, Vector, patience_sort_buckets)->RangeMultiplier(2)->Range(1, 1 << 18)->Complexity(benchmark::oNLogN);
+BENCHMARK_TEMPLATE(sorting, Vector, patience_sorter)->RangeMultiplier(2)->Range(1, 1 << 18)->Complexity(benchmark::oNLogN);
 BENCHMARK_TEMPLATE(sorting, Vector, patience_sort_list)->RangeMultiplier(2)->Range(1, 1 << 18)->Complexity(benchmark::oNLogN);
 BENCHMARK_TEMPLATE(sorting, Vector, std::sort)->RangeMultiplier(2)->Range(1, 1 << 18)->Complexity(benchmark::oNLogN);
 BENCHMARK_TEMPLATE(sorting, Vector, merge_sort)->RangeMultiplier(2)->Range(1, 1 << 18)->Complexity(benchmark::oNLogN);
 
+BENCHMARK_TEMPLATE(nearly_sorting, Vector, patience_sort_cont)->RangeMultiplier(2)->Range(1, 1 << 18)->Complexity(benchmark::oN);
+BENCHMARK_TEMPLATE(nearly_sorting, Vector, std::sort)->RangeMultiplier(2)->Range(1, 1 << 18)->Complexity(benchmark::oN);
+
+BENCHMARK_TEMPLATE(dealing, Patience::BinaryTops)->RangeMultiplier(4)->Range(1, 1 << 14);
+BENCHMARK_TEMPLATE(dealing, Patience::EytzingerTops)->RangeMultiplier(4)->Range(1, 1 << 14);
+BENCHMARK_TEMPLATE(dealing, Patience::AdaptiveTops)->RangeMultiplier(4)->Range(1, 1 << 14);
+
 BENCHMARK_TEMPLATE(list_sorting, patience_sort<std::list<int>>)->RangeMultiplier(2)->Range(1, 1 << 18)->Complexity(benchmark::oNLogN);
 BENCHMARK_TEMPLATE(list_sorting, list_qsort)->RangeMultiplier(2)->Range(1, 1 << 18)->Complexity(benchmark::oNLogN);
 
@@ -23,182 +23,2796 @@
  */
 
 #include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
 #include <deque>
+#include <exception>
+#include <functional>
+#include <limits>
+#include <iterator>
 #include <list>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <numeric>
+#include <new>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
 
 namespace Patience {
     
 template<typename T>
-static constexpr const bool is_list = std::is_same_v<T, std::list<typename T::value_type>>;
+static constexpr const bool is_list = false;
+
+template<typename T, typename Allocator>
+static constexpr const bool is_list<std::list<T, Allocator>> = true;
+
+static inline void prefetch(const void* ptr) noexcept
+{
+#if defined(__GNUC__)
+    __builtin_prefetch(ptr);
+#else
+    (void)ptr;
+#endif
+}
+
+static inline unsigned trailing_zeros(std::size_t val) noexcept
+{
+#if defined(__GNUC__)
+    return __builtin_ctzll(val);
+#else
+    unsigned result = 0;
+    for (; (val & 1) == 0; val >>= 1)
+        ++result;
+    return result;
+#endif
+}
+
+static inline unsigned popcount(unsigned val) noexcept
+{
+#if defined(__GNUC__)
+    return __builtin_popcount(val);
+#else
+    unsigned result = 0;
+    for (; val != 0; val &= val - 1)
+        ++result;
+    return result;
+#endif
+}
+
+// Vector registers for arithmetic keys.
+// less() returns a bit mask of lanes where a is less than b.
+template<typename Lane>
+struct Simd
+{
+    static constexpr const bool enabled = false;
+};
+
+#if defined(__AVX2__)
+template<>
+struct Simd<std::int32_t>
+{
+    static constexpr const bool enabled = true;
+    static constexpr const std::size_t lanes = 8;
+    static __m256i load(const void* p) noexcept { return _mm256_loadu_si256(static_cast<const __m256i*>(p)); }
+    static __m256i set1(std::int32_t v) noexcept { return _mm256_set1_epi32(v); }
+    static unsigned less(__m256i a, __m256i b) noexcept
+    {
+        return _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(b, a)));
+    }
+};
+
+template<>
+struct Simd<std::int64_t>
+{
+    static constexpr const bool enabled = true;
+    static constexpr const std::size_t lanes = 4;
+    static __m256i load(const void* p) noexcept { return _mm256_loadu_si256(static_cast<const __m256i*>(p)); }
+    static __m256i set1(std::int64_t v) noexcept { return _mm256_set1_epi64x(v); }
+    static unsigned less(__m256i a, __m256i b) noexcept
+    {
+        return _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(b, a)));
+    }
+};
+
+template<>
+struct Simd<float>
+{
+    static constexpr const bool enabled = true;
+    static constexpr const std::size_t lanes = 8;
+    static __m256 load(const void* p) noexcept { return _mm256_loadu_ps(static_cast<const float*>(p)); }
+    static __m256 set1(float v) noexcept { return _mm256_set1_ps(v); }
+    static unsigned less(__m256 a, __m256 b) noexcept { return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_LT_OQ)); }
+};
+
+template<>
+struct Simd<double>
+{
+    static constexpr const bool enabled = true;
+    static constexpr const std::size_t lanes = 4;
+    static __m256d load(const void* p) noexcept { return _mm256_loadu_pd(static_cast<const double*>(p)); }
+    static __m256d set1(double v) noexcept { return _mm256_set1_pd(v); }
+    static unsigned less(__m256d a, __m256d b) noexcept { return _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_LT_OQ)); }
+};
+#elif defined(__SSE2__)
+template<>
+struct Simd<std::int32_t>
+{
+    static constexpr const bool enabled = true;
+    static constexpr const std::size_t lanes = 4;
+    static __m128i load(const void* p) noexcept { return _mm_loadu_si128(static_cast<const __m128i*>(p)); }
+    static __m128i set1(std::int32_t v) noexcept { return _mm_set1_epi32(v); }
+    static unsigned less(__m128i a, __m128i b) noexcept
+    {
+        return _mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(a, b)));
+    }
+};
+
+#if defined(__SSE4_2__)
+template<>
+struct Simd<std::int64_t>
+{
+    static constexpr const bool enabled = true;
+    static constexpr const std::size_t lanes = 2;
+    static __m128i load(const void* p) noexcept { return _mm_loadu_si128(static_cast<const __m128i*>(p)); }
+    static __m128i set1(std::int64_t v) noexcept { return _mm_set1_epi64x(v); }
+    static unsigned less(__m128i a, __m128i b) noexcept
+    {
+        return _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(b, a)));
+    }
+};
+#endif
+
+template<>
+struct Simd<float>
+{
+    static constexpr const bool enabled = true;
+    static constexpr const std::size_t lanes = 4;
+    static __m128 load(const void* p) noexcept { return _mm_loadu_ps(static_cast<const float*>(p)); }
+    static __m128 set1(float v) noexcept { return _mm_set1_ps(v); }
+    static unsigned less(__m128 a, __m128 b) noexcept { return _mm_movemask_ps(_mm_cmplt_ps(a, b)); }
+};
+
+template<>
+struct Simd<double>
+{
+    static constexpr const bool enabled = true;
+    static constexpr const std::size_t lanes = 2;
+    static __m128d load(const void* p) noexcept { return _mm_loadu_pd(static_cast<const double*>(p)); }
+    static __m128d set1(double v) noexcept { return _mm_set1_pd(v); }
+    static unsigned less(__m128d a, __m128d b) noexcept { return _mm_movemask_pd(_mm_cmplt_pd(a, b)); }
+};
+#endif
+
+// Vector registers for bitonic merges of sorted blocks.
+// swap<d>() exchanges lanes i and i ^ d, blend<d>() takes lanes with bit d set from hi.
+// min(a, b) takes b only if b < a, and max(a, b) takes the other one, so each
+// exchange moves elements: floating lanes are selected by compare, as the min and max
+// instructions return the second operand for -0.0 and +0.0.
+template<typename Lane>
+struct Bitonic
+{
+    static constexpr const bool enabled = false;
+};
+
+// Mask of lanes with bit d set in their indices
+static constexpr unsigned blend_mask(std::size_t lanes, std::size_t d, std::size_t width = 1) noexcept
+{
+    unsigned mask = 0;
+    for (std::size_t i = 0; i < lanes; ++i)
+        if ((i & d) != 0)
+            mask |= ((1u << width) - 1) << (i * width);
+    return mask;
+}
+
+#if defined(__AVX512F__)
+// Full-mask forms are used as plain ones pass an undefined source, which GCC 12 reports as uninitialized
+static inline __m512i xor_lanes32(int d) noexcept
+{
+    return _mm512_xor_si512(_mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15), _mm512_set1_epi32(d));
+}
+
+static inline __m512i xor_lanes64(long long d) noexcept
+{
+    return _mm512_xor_si512(_mm512_setr_epi64(0, 1, 2, 3, 4, 5, 6, 7), _mm512_set1_epi64(d));
+}
+
+template<>
+struct Bitonic<std::int32_t>
+{
+    static constexpr const bool enabled = true;
+    static constexpr const std::size_t lanes = 16;
+    static __m512i load(const void* p) noexcept { return _mm512_loadu_si512(p); }
+    static void store(void* p, __m512i v) noexcept { _mm512_storeu_si512(p, v); }
+    static __m512i min(__m512i a, __m512i b) noexcept { return _mm512_mask_min_epi32(a, 0xFFFF, a, b); }
+    static __m512i max(__m512i a, __m512i b) noexcept { return _mm512_mask_max_epi32(a, 0xFFFF, a, b); }
+    static __m512i reverse(__m512i v) noexcept { return _mm512_mask_permutexvar_epi32(v, 0xFFFF, xor_lanes32(15), v); }
+    template<int d> static __m512i swap(__m512i v) noexcept { return _mm512_mask_permutexvar_epi32(v, 0xFFFF, xor_lanes32(d), v); }
+    template<int d> static __m512i blend(__m512i lo, __m512i hi) noexcept { return _mm512_mask_blend_epi32(blend_mask(lanes, d), lo, hi); }
+};
+
+template<>
+struct Bitonic<std::int64_t>
+{
+    static constexpr const bool enabled = true;
+    static constexpr const std::size_t lanes = 8;
+    static __m512i load(const void* p) noexcept { return _mm512_loadu_si512(p); }
+    static void store(void* p, __m512i v) noexcept { _mm512_storeu_si512(p, v); }
+    static __m512i min(__m512i a, __m512i b) noexcept { return _mm512_mask_min_epi64(a, 0xFF, a, b); }
+    static __m512i max(__m512i a, __m512i b) noexcept { return _mm512_mask_max_epi64(a, 0xFF, a, b); }
+    static __m512i reverse(__m512i v) noexcept { return _mm512_mask_permutexvar_epi64(v, 0xFF, xor_lanes64(7), v); }
+    template<int d> static __m512i swap(__m512i v) noexcept { return _mm512_mask_permutexvar_epi64(v, 0xFF, xor_lanes64(d), v); }
+    template<int d> static __m512i blend(__m512i lo, __m512i hi) noexcept { return _mm512_mask_blend_epi64(blend_mask(lanes, d), lo, hi); }
+};
+
+template<>
+struct Bitonic<float>
+{
+    static constexpr const bool enabled = true;
+    static constexpr const std::size_t lanes = 16;
+    static __m512 load(const void* p) noexcept { return _mm512_loadu_ps(p); }
+    static void store(void* p, __m512 v) noexcept { _mm512_storeu_ps(p, v); }
+    static __m512 min(__m512 a, __m512 b) noexcept { return _mm512_mask_blend_ps(_mm512_cmp_ps_mask(b, a, _CMP_LT_OQ), a, b); }
+    static __m512 max(__m512 a, __m512 b) noexcept { return _mm512_mask_blend_ps(_mm512_cmp_ps_mask(b, a, _CMP_LT_OQ), b, a); }
+    static __m512 reverse(__m512 v) noexcept { return _mm512_mask_permutexvar_ps(v, 0xFFFF, xor_lanes32(15), v); }
+    template<int d> static __m512 swap(__m512 v) noexcept { return _mm512_mask_permutexvar_ps(v, 0xFFFF, xor_lanes32(d), v); }
+    template<int d> static __m512 blend(__m512 lo, __m512 hi) noexcept { return _mm512_mask_blend_ps(blend_mask(lanes, d), lo, hi); }
+};
+
+template<>
+struct Bitonic<double>
+{
+    static constexpr const bool enabled = true;
+    static constexpr const std::size_t lanes = 8;
+    static __m512d load(const void* p) noexcept { return _mm512_loadu_pd(p); }
+    static void store(void* p, __m512d v) noexcept { _mm512_storeu_pd(p, v); }
+    static __m512d min(__m512d a, __m512d b) noexcept { return _mm512_mask_blend_pd(_mm512_cmp_pd_mask(b, a, _CMP_LT_OQ), a, b); }
+    static __m512d max(__m512d a, __m512d b) noexcept { return _mm512_mask_blend_pd(_mm512_cmp_pd_mask(b, a, _CMP_LT_OQ), b, a); }
+    static __m512d reverse(__m512d v) noexcept { return _mm512_mask_permutexvar_pd(v, 0xFF, xor_lanes64(7), v); }
+    template<int d> static __m512d swap(__m512d v) noexcept { return _mm512_mask_permutexvar_pd(v, 0xFF, xor_lanes64(d), v); }
+    template<int d> static __m512d blend(__m512d lo, __m512d hi) noexcept { return _mm512_mask_blend_pd(blend_mask(lanes, d), lo, hi); }
+};
+#elif defined(__AVX2__)
+template<>
+struct Bitonic<std::int32_t>
+{
+    static constexpr const bool enabled = true;
+    static constexpr const std::size_t lanes = 8;
+    static __m256i load(const void* p) noexcept { return _mm256_loadu_si256(static_cast<const __m256i*>(p)); }
+    static void store(void* p, __m256i v) noexcept { _mm256_storeu_si256(static_cast<__m256i*>(p), v); }
+    static __m256i min(__m256i a, __m256i b) noexcept { return _mm256_min_epi32(a, b); }
+    static __m256i max(__m256i a, __m256i b) noexcept { return _mm256_max_epi32(a, b); }
+    static __m256i reverse(__m256i v) noexcept { return _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0)); }
+
+    template<int d>
+    static __m256i swap(__m256i v) noexcept
+    {
+        if constexpr (d == 4)
+            return _mm256_permute2x128_si256(v, v, 1);
+        else if constexpr (d == 2)
+            return _mm256_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2));
+        else
+            return _mm256_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1));
+    }
+
+    template<int d> static __m256i blend(__m256i lo, __m256i hi) noexcept { return _mm256_blend_epi32(lo, hi, blend_mask(lanes, d)); }
+};
+
+template<>
+struct Bitonic<std::int64_t>
+{
+    static constexpr const bool enabled = true;
+    static constexpr const std::size_t lanes = 4;
+    static __m256i load(const void* p) noexcept { return _mm256_loadu_si256(static_cast<const __m256i*>(p)); }
+    static void store(void* p, __m256i v) noexcept { _mm256_storeu_si256(static_cast<__m256i*>(p), v); }
+    static __m256i min(__m256i a, __m256i b) noexcept { return _mm256_blendv_epi8(a, b, _mm256_cmpgt_epi64(a, b)); }
+    static __m256i max(__m256i a, __m256i b) noexcept { return _mm256_blendv_epi8(b, a, _mm256_cmpgt_epi64(a, b)); }
+    static __m256i reverse(__m256i v) noexcept { return _mm256_permute4x64_epi64(v, _MM_SHUFFLE(0, 1, 2, 3)); }
+
+    template<int d>
+    static __m256i swap(__m256i v) noexcept
+    {
+        if constexpr (d == 2)
+            return _mm256_permute4x64_epi64(v, _MM_SHUFFLE(1, 0, 3, 2));
+        else
+            return _mm256_permute4x64_epi64(v, _MM_SHUFFLE(2, 3, 0, 1));
+    }
+
+    template<int d> static __m256i blend(__m256i lo, __m256i hi) noexcept { return _mm256_blend_epi32(lo, hi, blend_mask(lanes, d, 2)); }
+};
+
+template<>
+struct Bitonic<float>
+{
+    static constexpr const bool enabled = true;
+    static constexpr const std::size_t lanes = 8;
+    static __m256 load(const void* p) noexcept { return _mm256_loadu_ps(static_cast<const float*>(p)); }
+    static void store(void* p, __m256 v) noexcept { _mm256_storeu_ps(static_cast<float*>(p), v); }
+    static __m256 min(__m256 a, __m256 b) noexcept { return _mm256_blendv_ps(a, b, _mm256_cmp_ps(b, a, _CMP_LT_OQ)); }
+    static __m256 max(__m256 a, __m256 b) noexcept { return _mm256_blendv_ps(b, a, _mm256_cmp_ps(b, a, _CMP_LT_OQ)); }
+    static __m256 reverse(__m256 v) noexcept { return _mm256_permutevar8x32_ps(v, _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0)); }
+
+    template<int d>
+    static __m256 swap(__m256 v) noexcept
+    {
+        if constexpr (d == 4)
+            return _mm256_permute2f128_ps(v, v, 1);
+        else if constexpr (d == 2)
+            return _mm256_permute_ps(v, _MM_SHUFFLE(1, 0, 3, 2));
+        else
+            return _mm256_permute_ps(v, _MM_SHUFFLE(2, 3, 0, 1));
+    }
+
+    template<int d> static __m256 blend(__m256 lo, __m256 hi) noexcept { return _mm256_blend_ps(lo, hi, blend_mask(lanes, d)); }
+};
+
+template<>
+struct Bitonic<double>
+{
+    static constexpr const bool enabled = true;
+    static constexpr const std::size_t lanes = 4;
+    static __m256d load(const void* p) noexcept { return _mm256_loadu_pd(static_cast<const double*>(p)); }
+    static void store(void* p, __m256d v) noexcept { _mm256_storeu_pd(static_cast<double*>(p), v); }
+    static __m256d min(__m256d a, __m256d b) noexcept { return _mm256_blendv_pd(a, b, _mm256_cmp_pd(b, a, _CMP_LT_OQ)); }
+    static __m256d max(__m256d a, __m256d b) noexcept { return _mm256_blendv_pd(b, a, _mm256_cmp_pd(b, a, _CMP_LT_OQ)); }
+    static __m256d reverse(__m256d v) noexcept { return _mm256_permute4x64_pd(v, _MM_SHUFFLE(0, 1, 2, 3)); }
+
+    template<int d>
+    static __m256d swap(__m256d v) noexcept
+    {
+        if constexpr (d == 2)
+            return _mm256_permute4x64_pd(v, _MM_SHUFFLE(1, 0, 3, 2));
+        else
+            return _mm256_permute4x64_pd(v, _MM_SHUFFLE(2, 3, 0, 1));
+    }
+
+    template<int d> static __m256d blend(__m256d lo, __m256d hi) noexcept { return _mm256_blend_pd(lo, hi, blend_mask(lanes, d)); }
+};
+#endif
+
+// Lane type of a key, so int and long share kernels with fixed width integers
+template<typename T, typename = void>
+struct SimdLane { using type = void; };
+
+template<typename T>
+struct SimdLane<T, std::enable_if_t<std::is_floating_point_v<T>>> { using type = T; };
+
+template<typename T>
+struct SimdLane<T, std::enable_if_t<std::is_integral_v<T> && std::is_signed_v<T> && sizeof(T) == 4>> { using type = std::int32_t; };
+
+template<typename T>
+struct SimdLane<T, std::enable_if_t<std::is_integral_v<T> && std::is_signed_v<T> && sizeof(T) == 8>> { using type = std::int64_t; };
+
+template<typename Compare, typename T>
+static constexpr const bool is_less = std::is_same_v<Compare, std::less<T>> || std::is_same_v<Compare, std::less<>>;
+
+template<typename Compare, typename T>
+static constexpr const bool is_greater = std::is_same_v<Compare, std::greater<T>> || std::is_same_v<Compare, std::greater<>>;
+
+template<typename T, typename Compare, typename Lane = typename SimdLane<T>::type>
+static constexpr const bool is_vector_key = Simd<Lane>::enabled && (is_less<Compare, T> || is_greater<Compare, T>);
+
+// Counts leading elements of a non-increasing range for which cmp(element, val) is false
+template<typename T, typename Compare>
+std::size_t count_vector_tops(const T* data, std::size_t size, T val) noexcept
+{
+    using Lane = typename SimdLane<T>::type;
+    using S = Simd<Lane>;
+    const auto key = S::set1(static_cast<Lane>(val));
+    std::size_t i = 0;
+    for (; i + S::lanes <= size; i += S::lanes) {
+        const auto tops = S::load(data + i);
+        unsigned mask = is_greater<Compare, T> ? S::less(key, tops) : S::less(tops, key);
+        if (mask != 0)
+            return i + S::lanes - popcount(mask);
+    }
+
+    Compare cmp;
+    while (i < size && !cmp(data[i], val))
+        ++i;
+    return i;
+}
+
+// Copies of deck tops in a contiguous array, searched by halving.
+// Tops do not increase from left to right, as new decks get the smallest values.
+template<typename T, typename Compare>
+class BinaryTops
+{
+public:
+    explicit BinaryTops(Compare cmp, std::pmr::memory_resource* resource = std::pmr::get_default_resource()) noexcept
+        : tops(resource)
+        , cmp(cmp)
+    { }
+
+    std::size_t size() const noexcept { return tops.size(); }
+    const T& operator[](std::size_t index) const noexcept { return tops[index]; }
+
+    // Returns index of the leftmost top which is less than val
+    std::size_t find(const T& val) const
+    {
+        return find(val, 0, tops.size());
+    }
+
+    void replace(std::size_t index, const T& val) { tops[index] = val; }
+    void push_back(const T& val) { tops.push_back(val); }
+    void reserve(std::size_t size) { tops.reserve(size); }
+    void clear() noexcept { tops.clear(); }
+
+protected:
+    static constexpr const std::size_t vector_window = 64;
+
+    // Same as above, but the answer is known to be within [begin, end]
+    std::size_t find(const T& val, std::size_t begin, std::size_t end) const
+    {
+        if constexpr (is_vector_key<T, Compare>) {
+            // Halve down to a short window, then scan it with vector compares
+            while (end - begin > vector_window) {
+                auto mid = begin + (end - begin) / 2;
+                if (cmp(tops[mid], val))
+                    end = mid;
+                else
+                    begin = mid + 1;
+            }
+            return begin + count_vector_tops<T, Compare>(tops.data() + begin, end - begin, val);
+        }
+        else {
+            auto it = find(val, tops.begin() + begin, tops.begin() + end);
+            return std::distance(tops.begin(), it);
+        }
+    }
+
+    template<typename TopIt>
+    TopIt find(const T& val, TopIt begin, TopIt end) const
+    {
+        if (end == begin)
+            return begin;
+
+        if (end == begin + 1)
+            return cmp(*begin, val) ? begin : end;
+
+        auto mid = std::next(begin, std::distance(begin, end) / 2);
+        return cmp(*mid, val)
+            ? find(val, begin, mid)
+            : find(val, mid, end);
+    }
+
+    std::pmr::vector<T> tops;
+    Compare cmp;
+};
+
+// Copies of deck tops in a contiguous array, searched from the deck hit last.
+// Few decks are scanned linearly, many decks are searched exponentially,
+// and plain halving is used in between.
+template<typename T, typename Compare>
+class AdaptiveTops : public BinaryTops<T, Compare>
+{
+    using Base = BinaryTops<T, Compare>;
+public:
+    static constexpr const std::size_t linear_limit = 16;
+    static constexpr const std::size_t exponential_limit = 4096;
+
+    explicit AdaptiveTops(Compare cmp, std::pmr::memory_resource* resource = std::pmr::get_default_resource()) noexcept
+        : Base(cmp, resource)
+    { }
+
+    std::size_t find(const T& val) const
+    {
+        auto size = this->size();
+        if (size == 0)
+            return 0;
+
+        if (size <= linear_limit)
+            return find_linear(val);
+
+        if (size <= exponential_limit)
+            return Base::find(val);
+
+        return find_exponential(val);
+    }
+
+    void replace(std::size_t index, const T& val)
+    {
+        Base::replace(index, val);
+        last = index;
+    }
+
+    void push_back(const T& val)
+    {
+        last = this->size();
+        Base::push_back(val);
+    }
+
+    void clear() noexcept
+    {
+        Base::clear();
+        last = 0;
+    }
+
+private:
+    bool less(std::size_t index, const T& val) const
+    {
+        return this->cmp(this->tops[index], val);
+    }
+
+    std::size_t find_linear(const T& val) const
+    {
+        auto index = last;
+        if (less(index, val)) {
+            while (index > 0 && less(index - 1, val))
+                --index;
+        }
+        else {
+            auto size = this->size();
+            while (++index < size && !less(index, val))
+                ;
+        }
+        return index;
+    }
+
+    std::size_t find_exponential(const T& val) const
+    {
+        std::size_t step = 1;
+        if (less(last, val)) {
+            // Answer is within [0, last]
+            auto end = last;
+            while (end >= step && less(end - step, val)) {
+                end -= step;
+                step *= 2;
+            }
+            auto begin = end >= step ? end - step + 1 : 0;
+            return Base::find(val, begin, end);
+        }
+
+        // Answer is within (last, size]
+        auto size = this->size();
+        auto begin = last + 1;
+        while (begin + step <= size && !less(begin + step - 1, val)) {
+            begin += step;
+            step *= 2;
+        }
+        return Base::find(val, begin, std::min(begin + step - 1, size));
+    }
+
+    std::size_t last = 0;
+};
+
+// Copies of deck tops in Eytzinger (BFS) order of a complete binary tree.
+// The descent is branchless and prefetches the cache line of the descendants of a node
+// log2(64 / sizeof(T)) levels below, as many as fit a 64-byte line.
+// Tree capacity is doubled when full; otherwise a new deck patches a single node.
+template<typename T, typename Compare>
+class EytzingerTops
+{
+public:
+    explicit EytzingerTops(Compare cmp, std::pmr::memory_resource* resource = std::pmr::get_default_resource()) noexcept
+        : tree(resource)
+        , cmp(cmp)
+    { }
+
+    std::size_t size() const noexcept { return count; }
+    const T& operator[](std::size_t index) const noexcept { return tree[node(index)]; }
+
+    std::size_t find(const T& val) const
+    {
+        if (count == 0)
+            return 0;
+
+        // Nodes with rank beyond count act as -infinity
+        const std::size_t bound = count + capacity() + 1;
+        const T* data = tree.data();
+        std::size_t k = 1;
+        for (unsigned shift = height; shift-- > 0;) {
+            prefetch(data + std::min(k * prefetch_stride, capacity()));
+            bool valid = ((2 * k + 1) << shift) <= bound;
+            k = 2 * k + (valid & !cmp(data[k], val));
+        }
+        k >>= trailing_zeros(~k) + 1;
+        return k == 0 ? count : rank(k);
+    }
+
+    void replace(std::size_t index, const T& val) { tree[node(index)] = val; }
+
+    void push_back(const T& val)
+    {
+        if (count == capacity())
+            grow(val);
+
+        tree[node(count++)] = val;
+    }
+
+    void reserve(std::size_t size)
+    {
+        unsigned full_height = 0;
+        while ((std::size_t{1} << full_height) - 1 < size)
+            ++full_height;
+        tree.reserve(std::size_t{1} << full_height);
+    }
+
+    void clear() noexcept
+    {
+        tree.clear();
+        count = 0;
+        height = 0;
+    }
+
+private:
+    // Descendants of k at this stride fill one cache line; keys of a line or larger prefetch k itself
+    static constexpr const std::size_t prefetch_stride = sizeof(T) < 64 ? 64 / sizeof(T) : 1;
+
+    std::size_t capacity() const noexcept { return (std::size_t{1} << height) - 1; }
+
+    // Eytzinger index of the element with the given in-order rank
+    std::size_t node(std::size_t rank) const noexcept { return node(rank, height); }
+
+    static std::size_t node(std::size_t rank, unsigned height) noexcept
+    {
+        unsigned shift = trailing_zeros(rank + 1);
+        return (std::size_t{1} << (height - 1 - shift)) + ((rank + 1) >> (shift + 1));
+    }
+
+    // In-order rank of the element at Eytzinger index k
+    std::size_t rank(std::size_t k) const noexcept
+    {
+        unsigned depth = 0;
+        while ((k >> (depth + 1)) != 0)
+            ++depth;
+        return ((2 * k + 1) << (height - 1 - depth)) - capacity() - 2;
+    }
+
+    // Each node gets a higher index in the taller tree,
+    // so nodes are moved in place starting from the end
+    void grow(const T& val)
+    {
+        ++height;
+        tree.resize(capacity() + 1, val);
+        for (std::size_t k = capacity(); k > 0; --k) {
+            auto r = rank(k);
+            if (r < count)
+                tree[k] = std::move(tree[node(r, height - 1)]);
+        }
+    }
+
+    std::pmr::vector<T> tree; // tree[0] is unused
+    std::size_t count = 0;
+    unsigned height = 0;
+    Compare cmp;
+};
+
+// Monotonic memory for decks, released all at once.
+// Chunks grow geometrically, so the number of allocations is logarithmic.
+class Arena
+{
+public:
+    explicit Arena(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) noexcept
+        : upstream(resource)
+    { }
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    ~Arena()
+    {
+        while (chunks != nullptr) {
+            auto next = chunks->next;
+            upstream->deallocate(chunks, sizeof(Chunk) + chunks->size, alignof(Chunk));
+            chunks = next;
+        }
+    }
+
+    void* allocate(std::size_t size, std::size_t alignment)
+    {
+        auto offset = (alignment - reinterpret_cast<std::uintptr_t>(current) % alignment) % alignment;
+        if (current == nullptr || offset + size > left) {
+            add_chunk(size + alignment);
+            offset = (alignment - reinterpret_cast<std::uintptr_t>(current) % alignment) % alignment;
+        }
+
+        auto result = current + offset;
+        current += offset + size;
+        left -= offset + size;
+        return result;
+    }
+
+private:
+    struct alignas(std::max_align_t) Chunk
+    {
+        Chunk* next;
+        std::size_t size;
+    };
+
+    static constexpr const std::size_t max_chunk_size = std::size_t{1} << 20;
+
+    void add_chunk(std::size_t size)
+    {
+        auto capacity = std::max(size, chunk_size);
+        auto raw = upstream->allocate(sizeof(Chunk) + capacity, alignof(Chunk));
+        chunks = new (raw) Chunk{chunks, capacity};
+        current = reinterpret_cast<char*>(chunks + 1);
+        left = capacity;
+        chunk_size = std::min(chunk_size * 2, max_chunk_size);
+    }
+
+    std::pmr::memory_resource* upstream;
+    Chunk* chunks = nullptr;
+    char* current = nullptr;
+    std::size_t left = 0;
+    std::size_t chunk_size = 4096;
+};
+
+// Deck as a chain of blocks carved from an Arena.
+// The first block holds a single element, each next one is twice larger up to a page,
+// so a deck costs a few words over its elements.
+template<typename T>
+class ArenaDeck
+{
+    struct Block
+    {
+        Block* next = nullptr;
+        std::size_t size = 0;
+        std::size_t capacity;
+
+        explicit Block(std::size_t capacity) noexcept : capacity(capacity) { }
+
+        T* data() noexcept { return reinterpret_cast<T*>(reinterpret_cast<char*>(this) + header_size); }
+    };
+
+    static constexpr const std::size_t header_size = (sizeof(Block) + alignof(T) - 1) / alignof(T) * alignof(T);
+    static constexpr const std::size_t max_block_capacity = sizeof(T) < 4096 ? 4096 / sizeof(T) : 1;
+
+public:
+    using value_type = T;
+    using arena_type = Arena;
+
+    class iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = T*;
+        using reference = T&;
+
+        iterator() = default;
+        iterator(Block* block, std::size_t index) noexcept : block(block), index(index) { }
+
+        reference operator*() const noexcept { return block->data()[index]; }
+        pointer operator->() const noexcept { return block->data() + index; }
+
+        iterator& operator++() noexcept
+        {
+            if (++index == block->size && block->next != nullptr) {
+                block = block->next;
+                index = 0;
+            }
+            return *this;
+        }
+
+        iterator operator++(int) noexcept { auto tmp = *this; ++*this; return tmp; }
+
+        bool operator==(const iterator& rhs) const noexcept { return block == rhs.block && index == rhs.index; }
+        bool operator!=(const iterator& rhs) const noexcept { return !(*this == rhs); }
+
+    private:
+        Block* block = nullptr;
+        std::size_t index = 0;
+    };
+
+    explicit ArenaDeck(Arena& arena) noexcept
+        : arena(&arena)
+    { }
+
+    ArenaDeck(const ArenaDeck&) = delete;
+    ArenaDeck& operator=(const ArenaDeck&) = delete;
+
+    ArenaDeck(ArenaDeck&& rhs) noexcept
+        : arena(rhs.arena), head(std::exchange(rhs.head, nullptr)), tail(std::exchange(rhs.tail, nullptr))
+    { }
+
+    ~ArenaDeck()
+    {
+        for (auto block = head; block != nullptr; block = block->next)
+            std::destroy_n(block->data(), block->size);
+    }
+
+    iterator begin() noexcept { return iterator(head, 0); }
+    iterator end() noexcept { return tail != nullptr ? iterator(tail, tail->size) : iterator(); }
+
+    T& back() noexcept { return tail->data()[tail->size - 1]; }
+
+    template<typename... Args>
+    void emplace_back(Args&&... args)
+    {
+        if (tail == nullptr || tail->size == tail->capacity)
+            add_block(tail == nullptr ? 1 : std::min(tail->capacity * 2, max_block_capacity));
+
+        new (tail->data() + tail->size) T(std::forward<Args>(args)...);
+        ++tail->size;
+    }
+
+    template<typename It>
+    void append(It first, It last)
+    {
+        for (; first != last; ++first)
+            emplace_back(*first);
+    }
+
+private:
+    void add_block(std::size_t capacity)
+    {
+        auto raw = arena->allocate(header_size + capacity * sizeof(T), std::max(alignof(Block), alignof(T)));
+        auto block = new (raw) Block(capacity);
+        (tail != nullptr ? tail->next : head) = block;
+        tail = block;
+    }
+
+    Arena* arena;
+    Block* head = nullptr;
+    Block* tail = nullptr;
+};
+
+template<typename It>
+static constexpr const bool is_random_access = std::is_base_of_v<std::random_access_iterator_tag, typename std::iterator_traits<It>::iterator_category>;
+
+template<typename It>
+static constexpr const bool is_forward = std::is_base_of_v<std::forward_iterator_tag, typename std::iterator_traits<It>::iterator_category>;
+
+// Deck kind for the two-pass counting install: decks are never built,
+// elements are scattered into a single buffer laid out deck by deck.
+template<typename T>
+struct Counting
+{
+    using value_type = T;
+};
+
+template<typename T>
+static constexpr const bool is_counting = false;
+
+template<typename T>
+static constexpr const bool is_counting<Counting<T>> = true;
+
+// Output iterator which move-constructs elements in uninitialized memory
+// and counts them, so the owner of elements written in order knows which ones to destroy.
+// Trivially destructible elements are not counted, as they need no destruction.
+template<typename T>
+class ConstructIterator
+{
+public:
+    using iterator_category = std::output_iterator_tag;
+    using value_type = void;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = void;
+
+    ConstructIterator(T* ptr, std::size_t& constructed) noexcept : ptr(ptr), constructed(&constructed) { }
+
+    T* base() const noexcept { return ptr; }
+
+    ConstructIterator& operator*() noexcept { return *this; }
+    ConstructIterator& operator++() noexcept { ++ptr; return *this; }
+    ConstructIterator operator++(int) noexcept { return ConstructIterator(ptr++, *constructed); }
+    ConstructIterator operator+(std::size_t offset) const noexcept { return ConstructIterator(ptr + offset, *constructed); }
+
+    ConstructIterator& operator=(T&& val)
+    {
+        new (ptr) T(std::move(val));
+        if constexpr (!std::is_trivially_destructible_v<T>)
+            ++*constructed;
+        return *this;
+    }
+
+private:
+    T* ptr;
+    std::size_t* constructed;
+};
+
+// Uninitialized storage for elements which are all constructed by the owner
+template<typename T>
+class Buffer
+{
+public:
+    explicit Buffer(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) noexcept
+        : allocator(resource)
+    { }
+
+    explicit Buffer(std::size_t capacity, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : Buffer(resource)
+    {
+        reserve(capacity);
+    }
+
+    Buffer(const Buffer&) = delete;
+    Buffer& operator=(const Buffer&) = delete;
+
+    ~Buffer()
+    {
+        clear();
+        if (storage != nullptr)
+            allocator.deallocate(storage, capacity);
+    }
+
+    T* data() noexcept { return storage; }
+
+    // Grows the storage, which must have no constructed elements
+    void reserve(std::size_t size)
+    {
+        if (size <= capacity)
+            return;
+
+        if (storage != nullptr)
+            allocator.deallocate(storage, capacity);
+        storage = nullptr;
+        capacity = 0;
+        storage = allocator.allocate(size);
+        capacity = size;
+    }
+
+    // Marks the first elements as constructed by the owner
+    void set_constructed(std::size_t size) noexcept { constructed = size; }
+
+    // Output iterator constructing elements in order from the start of the storage,
+    // which must have no constructed elements. Elements it constructed are destroyed
+    // by the buffer even if the owner stops on an exception.
+    ConstructIterator<T> appender() noexcept { return ConstructIterator<T>(storage, constructed); }
+
+    void clear() noexcept
+    {
+        std::destroy_n(storage, constructed);
+        constructed = 0;
+    }
+
+private:
+    std::pmr::polymorphic_allocator<T> allocator;
+    T* storage = nullptr;
+    std::size_t capacity = 0;
+    std::size_t constructed = 0;
+};
+
+template<typename Deck, typename = void>
+struct DeckArena
+{
+    struct type
+    {
+        explicit type(std::pmr::memory_resource*) noexcept { }
+    };
+    static constexpr const bool enabled = false;
+};
+
+template<typename Deck>
+struct DeckArena<Deck, std::void_t<typename Deck::arena_type>>
+{
+    using type = typename Deck::arena_type;
+    static constexpr const bool enabled = true;
+};
+
+// Allocates from a memory resource, but constructs elements without passing the resource to them.
+// List decks are built with the allocator of the sorted list, so nodes can be spliced between them.
+template<typename T>
+class PlainAllocator : public std::pmr::polymorphic_allocator<T>
+{
+public:
+    using std::pmr::polymorphic_allocator<T>::polymorphic_allocator;
+
+    template<typename U>
+    PlainAllocator(const PlainAllocator<U>& other) noexcept
+        : std::pmr::polymorphic_allocator<T>(other.resource())
+    { }
+
+    template<typename U, typename... Args>
+    void construct(U* p, Args&&... args)
+    {
+        new (p) U(std::forward<Args>(args)...);
+    }
+
+    PlainAllocator select_on_container_copy_construction() const noexcept { return *this; }
+};
+
+template<typename Deck>
+using DeckContainer = std::conditional_t<is_list<Deck>, std::deque<Deck, PlainAllocator<Deck>>, std::pmr::deque<Deck>>;
+
+template<typename Deck, typename It>
+void append(Deck& deck, It first, It last)
+{
+    deck.insert(deck.end(), first, last);
+}
+
+template<typename T, typename It>
+void append(ArenaDeck<T>& deck, It first, It last)
+{
+    deck.append(first, last);
+}
+
+struct Identity
+{
+    template<typename T>
+    const T& operator()(const T& val) const noexcept { return val; }
+};
+
+// Compares elements by their projections
+template<typename Compare, typename Proj>
+struct ProjectedCompare
+{
+    template<typename T>
+    bool operator()(const T& lhs, const T& rhs) const
+    {
+        return cmp(std::invoke(proj, lhs), std::invoke(proj, rhs));
+    }
+
+    Compare cmp;
+    Proj proj;
+};
+
+// Compares values behind pointers
+template<typename Compare>
+struct PointeeCompare
+{
+    template<typename T>
+    bool operator()(const T* lhs, const T* rhs) const
+    {
+        return cmp(*lhs, *rhs);
+    }
+
+    Compare cmp;
+};
+
+template<typename Compare, typename Proj>
+auto project(Compare cmp, Proj proj)
+{
+    if constexpr (std::is_same_v<Proj, Identity>)
+        return cmp;
+    else
+        return ProjectedCompare<Compare, Proj>{cmp, proj};
+}
+
+// Deals elements to decks. Compare is applied to keys produced by Proj,
+// and only keys are kept as deck tops. Keys which are not trivially copyable
+// are not copied: tops point to the keys of the last elements of decks,
+// so move-only elements can be sorted as well.
+template<typename Deck, typename Compare, template<typename, typename> typename Tops = BinaryTops, typename Proj = Identity>
+class Installer
+{
+    using T = typename Deck::value_type;
+    using Key = std::decay_t<std::invoke_result_t<Proj&, const T&>>;
+    static constexpr const bool copy_keys = std::is_trivially_copyable_v<Key> || !std::is_reference_v<std::invoke_result_t<Proj&, const T&>>;
+    using TopCompare = std::conditional_t<copy_keys, Compare, PointeeCompare<Compare>>;
+public:
+    // Type of deck tops: a copy of the key or a pointer to it
+    using TopKey = std::conditional_t<copy_keys, Key, const Key*>;
+
+    explicit Installer(Compare cmp, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : Installer(cmp, Proj(), resource)
+    { }
+
+    Installer(Compare cmp, Proj proj, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : arena(resource)
+        , decks(resource)
+        , tops(TopCompare{cmp}, resource)
+        , indices(resource)
+        , offsets(resource)
+        , cmp(cmp)
+        , proj(proj)
+    { }
+
+    void reserve(std::size_t size)
+    {
+        tops.reserve(size);
+        indices.reserve(size);
+        offsets.reserve(size + 1);
+    }
+
+    void clear() noexcept
+    {
+        decks.clear();
+        tops.clear();
+    }
+
+    template<typename It>
+    auto install(It begin, It end)
+    {
+        deal(begin, end);
+        if constexpr (is_list<Deck>)
+            return std::move(decks);
+        else
+            return install_back(begin);
+    }
+
+    // Moves elements to decks
+    template<typename It>
+    void deal(It begin, It end)
+    {
+        for (auto it = begin; it != end;) {
+            auto index = tops.find(top_key(*it));
+            auto run_end = std::next(find_run_last(index, it, end));
+            auto target = get_deck_pointer(index);
+            append(*target, std::make_move_iterator(it), std::make_move_iterator(run_end));
+            update_top(index, target->back());
+            it = run_end;
+        }
+    }
+
+    std::size_t size() const noexcept { return tops.size(); }
+
+    // Moves dealt decks one after another to out, appends offsets of their ends to bounds
+    // and, if points are given, positions of out at these offsets to points
+    template<typename Out, typename Bounds, typename... Points>
+    void collect(Out out, Bounds& bounds, Points&... points)
+    {
+        std::size_t offset = 0;
+        bounds.push_back(offset);
+        (points.push_back(out), ...);
+        for (auto& deck : decks) {
+            for (auto& val : deck) {
+                *out++ = std::move(val);
+                ++offset;
+            }
+            bounds.push_back(offset);
+            (points.push_back(out), ...);
+        }
+    }
+
+    auto install(Deck& list)
+    {
+        static_assert(is_list<Deck>);
+        for (auto it = list.begin(); it != list.end();) {
+            auto index = tops.find(top_key(*it));
+            auto run_end = std::next(find_run_last(index, it, list.end()));
+            auto target = get_deck_pointer(index, list.get_allocator());
+            target->splice(target->end(), list, it, run_end);
+            update_top(index, target->back());
+            it = run_end;
+        }
+        return std::move(decks);
+    }
+
+    // Records the deck of each element first, then moves elements into the buffer
+    // so each deck is a contiguous range. Replaces bounds with offsets of these ranges.
+    template<typename It, typename Bounds>
+    void scatter(It begin, It end, T* buffer, Bounds& bounds)
+    {
+        count(begin, end, bounds);
+        auto it = begin;
+        for (auto index : indices)
+            new (buffer + offsets[index]++) T(std::move(*it++));
+    }
+
+    // Same as scatter, but the input is copied
+    template<typename It, typename Bounds>
+    void scatter_copy(It begin, It end, T* buffer, Bounds& bounds)
+    {
+        count(begin, end, bounds);
+        auto it = begin;
+        for (auto index : indices)
+            new (buffer + offsets[index]++) T(std::as_const(*it++));
+    }
+
+private:
+    // First pass of scatter: finds the deck of each element and offsets of decks in the buffer.
+    // The input is read twice, so it is walked with a running position.
+    template<typename It, typename Bounds>
+    void count(It begin, It end, Bounds& bounds)
+    {
+        static_assert(is_forward<It>, "counting install reads the input twice and needs forward iterators");
+        indices.resize(std::distance(begin, end));
+        std::size_t position = 0;
+        for (auto it = begin; it != end;) {
+            auto index = tops.find(top_key(*it));
+            auto run_last = find_run_last(index, it, end);
+            update_top(index, *run_last);
+            auto run_end = std::next(run_last);
+            auto length = static_cast<std::size_t>(std::distance(it, run_end));
+            std::fill_n(indices.begin() + position, length, index);
+            position += length;
+            it = run_end;
+        }
+
+        offsets.assign(tops.size() + 1, 0);
+        for (auto index : indices)
+            ++offsets[index + 1];
+        std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+        bounds.assign(offsets.begin(), offsets.end());
+    }
+
+    // Puts partially sorted data back to input
+    // Generates ranges of sorted data
+    template<typename It>
+    auto install_back(It begin)
+    {
+        std::pmr::deque<std::pair<It, It>> points(decks.get_allocator().resource());
+        auto end = begin;
+        for (auto& deck : decks) {
+            auto range_begin = end;
+            end = std::move(deck.begin(), deck.end(), range_begin);
+            points.emplace_back(range_begin, end);
+        }
+        return points;
+    }
+
+    decltype(auto) key(const T& val) const { return std::invoke(proj, val); }
+
+    decltype(auto) top_key(const T& val) const
+    {
+        if constexpr (copy_keys)
+            return key(val);
+        else
+            return &key(val);
+    }
+
+    const Key& top(std::size_t index) const
+    {
+        if constexpr (copy_keys)
+            return tops[index];
+        else
+            return *tops[index];
+    }
+
+    // Finds the last element of the run starting at begin which goes to the deck at index:
+    // each next element would be put right on top of the previous one.
+    template<typename It>
+    It find_run_last(std::size_t index, It begin, It end) const
+    {
+        const Key* left_top = index != 0 ? &top(index - 1) : nullptr;
+        auto last = begin;
+        for (auto it = std::next(begin); it != end; last = it++) {
+            decltype(auto) next = key(*it);
+            if (!cmp(key(*last), next) || (left_top != nullptr && cmp(*left_top, next)))
+                break;
+        }
+
+        return last;
+    }
+
+    // Puts top of the run to the deck at index, which is a new deck if index is past the last one
+    void update_top(std::size_t index, const T& last)
+    {
+        if (index == tops.size())
+            tops.push_back(top_key(last));
+        else
+            tops.replace(index, top_key(last));
+    }
+
+    // Starts a new deck if index is past the last one
+    template<typename... Args>
+    auto get_deck_pointer(std::size_t index, const Args&... args)
+    {
+        if (index == decks.size())
+            allocate_new_deck(args...);
+
+        return decks.begin() + index;
+    }
+
+    template<typename... Args>
+    void allocate_new_deck(const Args&... args)
+    {
+        if constexpr (DeckArena<Deck>::enabled)
+            decks.emplace_back(arena);
+        else
+            decks.emplace_back(args...);
+    }
+
+    typename DeckArena<Deck>::type arena;
+    DeckContainer<Deck> decks;
+    Tops<TopKey, TopCompare> tops;
+    std::pmr::vector<std::size_t> indices; // for scatter()
+    std::pmr::vector<std::size_t> offsets;
+    Compare cmp;
+    Proj proj;
+};
+
+template<typename Deck, template<typename, typename> typename Tops = BinaryTops, typename It, typename Compare, typename Proj = Identity>
+auto install(It begin, It end, Compare cmp, std::pmr::memory_resource* resource = std::pmr::get_default_resource(), Proj proj = Proj())
+{
+    return Installer<Deck, Compare, Tops, Proj>(cmp, proj, resource).install(begin, end);
+}
+
+template<typename Deck, template<typename, typename> typename Tops = BinaryTops, typename List, typename Compare>
+auto install(List& list, Compare cmp, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+{
+    return Installer<Deck, Compare, Tops>(cmp, resource).install(list);
+}
+
+// Compares in the opposite order, so merging reversed ranges goes backwards
+template<typename Compare>
+struct Flipped
+{
+    template<typename T>
+    bool operator()(const T& lhs, const T& rhs) const { return cmp(rhs, lhs); }
+
+    Compare cmp;
+};
+
+// Finds the first element in [first, last) for which pred is false, pred being true on a prefix.
+// Steps from first grow exponentially, so the cost is logarithmic in the distance to the result.
+template<typename It, typename Pred>
+It gallop(It first, It last, Pred pred)
+{
+    if constexpr (is_random_access<It>) {
+        auto size = last - first;
+        decltype(size) bound = 1;
+        while (bound <= size && pred(first[bound - 1]))
+            bound *= 2;
+        return std::partition_point(first + bound / 2, first + std::min(bound, size), pred);
+    }
+    else {
+        return std::find_if_not(first, last, pred);
+    }
+}
+
+// Moves merged [a, a_last) and [b, b_last) to out, taking a on ties, until one of them ends.
+// After min_gallop elements in a row come from one range, the rest of that stretch
+// is found by gallop and moved at once, as in TimSort. Positions are advanced in place,
+// so they are known to the caller if a comparison throws.
+template<typename It1, typename It2, typename Out, typename Compare>
+void gallop_merge_tracked(It1& a, It1 a_last, It2& b, It2 b_last, Out& out, Compare cmp)
+{
+    static constexpr const int min_gallop = 7;
+    int a_count = 0;
+    int b_count = 0;
+    while (a != a_last && b != b_last) {
+        if (cmp(*b, *a)) {
+            *out++ = std::move(*b++);
+            a_count = 0;
+            if (++b_count == min_gallop) {
+                auto stretch = gallop(b, b_last, [&](const auto& val) { return cmp(val, *a); });
+                out = std::move(b, stretch, out);
+                b = stretch;
+                b_count = 0;
+            }
+        }
+        else {
+            *out++ = std::move(*a++);
+            b_count = 0;
+            if (++a_count == min_gallop) {
+                auto stretch = gallop(a, a_last, [&](const auto& val) { return !cmp(*b, val); });
+                out = std::move(a, stretch, out);
+                a = stretch;
+                a_count = 0;
+            }
+        }
+    }
+}
+
+// Same as above, but returns where the merge stopped
+template<typename It1, typename It2, typename Out, typename Compare>
+std::tuple<It1, It2, Out> gallop_merge(It1 a, It1 a_last, It2 b, It2 b_last, Out out, Compare cmp)
+{
+    gallop_merge_tracked(a, a_last, b, b_last, out, cmp);
+    return {a, b, out};
+}
+
+// Standard comparisons of arithmetic types, which compile to conditional moves
+template<typename T, typename Compare>
+static constexpr const bool is_branchless = std::is_arithmetic_v<T> && (is_less<Compare, T> || is_greater<Compare, T>);
+
+template<typename T, typename Compare>
+static constexpr const bool is_branchless<T, Flipped<Compare>> = is_branchless<T, Compare>;
+
+// Same contract as gallop_merge, but the element to take is selected without branches.
+// Before each couple of steps, a check whether the next stretch of either range
+// goes as a whole keeps runs of nearly sorted data from costing a step per element.
+template<typename It1, typename It2, typename Out, typename Compare>
+std::tuple<It1, It2, Out> branchless_merge(It1 a, It1 a_last, It2 b, It2 b_last, Out out, Compare cmp)
+{
+    static constexpr const std::ptrdiff_t stretch_check = 8;
+    static constexpr const std::ptrdiff_t steps_between_checks = 2;
+    while (a != a_last && b != b_last) {
+        // Neither range can end within the shorter length, so these steps go unchecked
+        auto steps = std::min<std::ptrdiff_t>(a_last - a, b_last - b);
+        if (steps >= stretch_check) {
+            if (!cmp(*b, a[stretch_check - 1])) {
+                auto stretch = gallop(a + stretch_check, a_last, [&](const auto& val) { return !cmp(*b, val); });
+                out = std::move(a, stretch, out);
+                a = stretch;
+                continue;
+            }
+            if (cmp(b[stretch_check - 1], *a)) {
+                auto stretch = gallop(b + stretch_check, b_last, [&](const auto& val) { return cmp(val, *a); });
+                out = std::move(b, stretch, out);
+                b = stretch;
+                continue;
+            }
+            steps = steps_between_checks;
+        }
+        for (; steps != 0; --steps) {
+            bool take_b = cmp(*b, *a);
+            auto val = take_b ? *b : *a;
+            *out = std::move(val);
+            ++out;
+            b += take_b;
+            a += !take_b;
+        }
+    }
+    return {a, b, out};
+}
+
+template<typename T, typename Compare, typename Lane = typename SimdLane<T>::type>
+static constexpr const bool is_bitonic_key = Bitonic<Lane>::enabled && (is_less<Compare, T> || is_greater<Compare, T>);
+
+// Iterators to contiguous memory, which is accessed by pointers in vector kernels
+template<typename T, typename It>
+static constexpr const bool is_contiguous = std::is_same_v<It, T*>
+    || std::is_same_v<It, typename std::vector<T>::iterator>
+    || std::is_same_v<It, ConstructIterator<T>>;
+
+template<typename T>
+T* address(T* ptr) noexcept { return ptr; }
+
+template<typename T>
+T* address(ConstructIterator<T> it) noexcept { return it.base(); }
+
+template<typename It>
+auto address(It it) noexcept { return std::addressof(*it); }
+
+// Sorts a bitonic register: step d puts the smaller of lanes i and i ^ d to the lower lane
+template<typename B, bool Descending, int d = B::lanes / 2, typename Reg>
+Reg sort_bitonic(Reg v) noexcept
+{
+    // Lane i ^ d sees the pair in the opposite order, so it takes the element lane i leaves
+    auto swapped = B::template swap<d>(v);
+    auto lo = Descending ? B::max(v, swapped) : B::min(v, swapped);
+    auto hi = Descending ? B::min(swapped, v) : B::max(swapped, v);
+    v = B::template blend<d>(lo, hi);
+    if constexpr (d > 1)
+        return sort_bitonic<B, Descending, d / 2>(v);
+    else
+        return v;
+}
+
+// Merges two sorted registers: lo gets the first half of the result, hi gets the second one
+template<typename B, bool Descending, typename Reg>
+void merge_bitonic(Reg& lo, Reg& hi) noexcept
+{
+    auto reversed = B::reverse(hi);
+    auto first = Descending ? B::max(lo, reversed) : B::min(lo, reversed);
+    auto second = Descending ? B::min(lo, reversed) : B::max(lo, reversed);
+    lo = sort_bitonic<B, Descending>(first);
+    hi = sort_bitonic<B, Descending>(second);
+}
+
+// Merges all of [a, a_last) and [b, b_last) to out, which may end where b ends
+template<typename T, typename Compare>
+T* merge_all(T* a, T* a_last, T* b, T* b_last, T* out, Compare cmp) noexcept
+{
+    std::tie(a, b, out) = branchless_merge(a, a_last, b, b_last, out, cmp);
+    out = std::copy(a, a_last, out);
+    return std::copy(b, b_last, out);
+}
+
+// Same contract as merge_all. The next block goes through a bitonic network
+// with the second half of the previous result, and the block is taken from the range
+// whose head goes first, so the first half is always final. When that range has
+// no full block left, it is merged with the pending half and then with the other range.
+template<typename T, typename Compare>
+T* bitonic_merge(T* a, T* a_last, T* b, T* b_last, T* out, Compare cmp) noexcept
+{
+    using B = Bitonic<typename SimdLane<T>::type>;
+    static constexpr const bool descending = is_greater<Compare, T>;
+    static constexpr const std::ptrdiff_t lanes = B::lanes;
+
+    if (a_last - a < lanes || b_last - b < lanes)
+        return merge_all(a, a_last, b, b_last, out, cmp);
+
+    auto lo = B::load(a);
+    auto hi = B::load(b);
+    a += lanes;
+    b += lanes;
+    bool from_a;
+    while (true) {
+        merge_bitonic<B, descending>(lo, hi);
+        B::store(out, lo);
+        out += lanes;
+        lo = hi;
+        from_a = b == b_last || (a != a_last && !cmp(*b, *a));
+        auto& next = from_a ? a : b;
+        if ((from_a ? a_last : b_last) - next < lanes)
+            break;
+        hi = B::load(next);
+        next += lanes;
+    }
+
+    T pending[lanes];
+    T tail[lanes * 2];
+    B::store(pending, lo);
+    if (from_a) {
+        auto tail_end = merge_all(pending, pending + lanes, a, a_last, tail, cmp);
+        return merge_all(tail, tail_end, b, b_last, out, cmp);
+    }
+    auto tail_end = merge_all(pending, pending + lanes, b, b_last, tail, cmp);
+    return merge_all(a, a_last, tail, tail_end, out, cmp);
+}
+
+// Branchless kernel for arithmetic types with standard comparisons, galloping one otherwise
+template<typename It1, typename It2, typename Out, typename Compare>
+std::tuple<It1, It2, Out> merge_kernel(It1 a, It1 a_last, It2 b, It2 b_last, Out out, Compare cmp)
+{
+    using T = typename std::iterator_traits<It1>::value_type;
+    if constexpr (is_bitonic_key<T, Compare> && is_contiguous<T, It1> && is_contiguous<T, It2> && is_contiguous<T, Out>) {
+        if (a == a_last || b == b_last)
+            return {a, b, out};
+        auto first = address(out);
+        auto last = bitonic_merge(address(a), address(a) + (a_last - a), address(b), address(b) + (b_last - b), first, cmp);
+        return {a_last, b_last, out + (last - first)};
+    }
+    else if constexpr (is_branchless<T, Compare> && is_random_access<It1> && is_random_access<It2>)
+        return branchless_merge(a, a_last, b, b_last, out, cmp);
+    else
+        return gallop_merge(a, a_last, b, b_last, out, cmp);
+}
+
+// Same as merge_kernel, but positions are advanced in place, so they are known if a comparison throws.
+// Vector and branchless kernels are used for standard comparisons of arithmetic types only, which do not throw.
+template<typename It1, typename It2, typename Out, typename Compare>
+void merge_kernel_tracked(It1& a, It1 a_last, It2& b, It2 b_last, Out& out, Compare cmp)
+{
+    using T = typename std::iterator_traits<It1>::value_type;
+    if constexpr (is_branchless<T, Compare> || is_bitonic_key<T, Compare>)
+        std::tie(a, b, out) = merge_kernel(a, a_last, b, b_last, out, cmp);
+    else
+        gallop_merge_tracked(a, a_last, b, b_last, out, cmp);
+}
+
+// Merges [a, a_last) moved to scratch with [b, b_last) to out, the gap left by the moved elements,
+// and destroys the scratch. If a comparison throws, elements left in the scratch go back
+// to the gap first, so the range keeps all of its elements.
+template<typename Scratch, typename It, typename Compare>
+void merge_from_scratch(Scratch a, Scratch a_last, It b, It b_last, It out, Compare cmp)
+{
+    auto scratch = a;
+    try {
+        merge_kernel_tracked(a, a_last, b, b_last, out, cmp);
+    }
+    catch (...) {
+        std::move(a, a_last, out);
+        std::destroy(scratch, a_last);
+        throw;
+    }
+    std::move(a, a_last, out);
+    std::destroy(scratch, a_last);
+}
+
+// Merges adjacent ranges moving the shorter one to uninitialized scratch.
+// Ranges in order are left as is, swapped ranges are rotated, and elements
+// which are already in place at both ends are skipped by gallop.
+template<typename It, typename T, typename Compare>
+void merge_range(std::pair<It, It>& r1, std::pair<It, It>& r2, Compare cmp, T* scratch)
+{
+    auto first = r1.first;
+    r2.first = first;
+    if (r1.first == r1.second || r1.second == r2.second || !cmp(*r1.second, *std::prev(r1.second)))
+        return;
+
+    if (cmp(*std::prev(r2.second), *r1.first)) {
+        std::rotate(r1.first, r1.second, r2.second);
+        return;
+    }
+
+    auto middle = r1.second;
+    auto last = r2.second;
+    first = gallop(first, middle, [&](const auto& val) { return !cmp(*middle, val); });
+    auto reversed = gallop(std::make_reverse_iterator(last), std::make_reverse_iterator(middle),
+                           [&](const auto& val) { return !cmp(val, *std::prev(middle)); });
+    last = reversed.base();
+
+    if (std::distance(first, middle) <= std::distance(middle, last)) {
+        auto scratch_end = std::uninitialized_move(first, middle, scratch);
+        merge_from_scratch(scratch, scratch_end, middle, last, first, cmp);
+    }
+    else {
+        auto scratch_end = std::uninitialized_move(middle, last, scratch);
+        merge_from_scratch(std::make_reverse_iterator(scratch_end), std::make_reverse_iterator(scratch),
+                           std::make_reverse_iterator(middle), std::make_reverse_iterator(first),
+                           std::make_reverse_iterator(last), Flipped<Compare>{cmp});
+    }
+}
+
+// Lists in order or swapped are spliced, otherwise nodes are relinked by merge.
+// Elements of l1 go first on ties.
+template<typename T, typename Allocator, typename Compare>
+void merge_range(std::list<T, Allocator>& l1, std::list<T, Allocator>& l2, Compare cmp)
+{
+    if (l1.empty() || l2.empty() || !cmp(l2.front(), l1.back()))
+        l2.splice(l2.begin(), l1);
+    else if (cmp(l2.back(), l1.front()))
+        l2.splice(l2.end(), l1);
+    else {
+        l1.merge(l2, cmp);
+        l2.swap(l1);
+    }
+}
+
+// Drops bounds between ranges merged by a round of merge_level, which pairs ranges from the end
+template<typename Bounds>
+void join_bounds(Bounds& bounds)
+{
+    auto out = bounds.size();
+    for (auto i = bounds.size() - 1; i >= 2; i -= 2)
+        bounds[--out] = bounds[i];
+    if (bounds.size() % 2 == 1)
+        bounds[--out] = bounds[0];
+    else
+        bounds[--out] = bounds[1], bounds[--out] = bounds[0];
+    bounds.erase(bounds.begin(), bounds.begin() + out);
+}
+
+// Number of rounds merge_levels needs for count ranges
+inline std::size_t merge_depth(std::size_t count) noexcept
+{
+    std::size_t depth = 0;
+    for (; count > 1; count = (count + 1) / 2)
+        ++depth;
+    return depth;
+}
+
+// Merges adjacent ranges [first, middle) and [middle, last) to out, which must not overlap them
+// Ranges in order are moved at once.
+template<typename It, typename Out, typename Compare>
+Out move_merge(It first, It middle, It last, Out out, Compare cmp)
+{
+    auto a = first;
+    auto b = middle;
+    if (first != middle && middle != last && cmp(*middle, *std::prev(middle)))
+        std::tie(a, b, out) = merge_kernel(first, middle, middle, last, out, cmp);
+    out = std::move(a, middle, out);
+    return std::move(b, last, out);
+}
+
+// Fixed set of worker threads which run tasks in rounds together with the calling thread.
+// A round is finished when all its tasks are, so rounds are separated by a barrier.
+// Parallel sorts accept any executor with the same size() and for_each(count, f),
+// so they can run on an existing pool of the application.
+class ThreadPool
+{
+public:
+    explicit ThreadPool(unsigned threads = std::thread::hardware_concurrency())
+    {
+        for (unsigned i = 1; i < threads; ++i)
+            workers.emplace_back([this] { work(); });
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        wake.notify_all();
+        for (auto& worker : workers)
+            worker.join();
+    }
+
+    // Number of threads running tasks, including the calling one
+    std::size_t size() const noexcept { return workers.size() + 1; }
+
+    // Runs f(0), ..., f(count - 1) and returns when all of them are finished.
+    // The first exception thrown by a task is rethrown after the round.
+    template<typename F>
+    void for_each(std::size_t count, F f)
+    {
+        if (count <= 1 || workers.empty()) {
+            for (std::size_t i = 0; i < count; ++i)
+                f(i);
+            return;
+        }
+
+        std::lock_guard<std::mutex> round_lock(round_mutex);
+        std::unique_lock<std::mutex> lock(mutex);
+        task = [&f](std::size_t i) { f(i); };
+        next = 0;
+        total = count;
+        wake.notify_all();
+        run(lock);
+        done.wait(lock, [this] { return next == total && active == 0; });
+        task = nullptr;
+        if (error != nullptr)
+            std::rethrow_exception(std::exchange(error, nullptr));
+    }
+
+private:
+    // Takes tasks of the current round until there are none, the mutex is locked between tasks
+    void run(std::unique_lock<std::mutex>& lock)
+    {
+        while (next < total) {
+            auto i = next++;
+            ++active;
+            lock.unlock();
+            std::exception_ptr exception;
+            try {
+                task(i);
+            }
+            catch (...) {
+                exception = std::current_exception();
+            }
+            lock.lock();
+            if (exception != nullptr && error == nullptr)
+                error = exception;
+            --active;
+        }
+        if (active == 0)
+            done.notify_all();
+    }
+
+    void work()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            wake.wait(lock, [this] { return stop || next < total; });
+            if (stop)
+                return;
+            run(lock);
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::mutex round_mutex;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    std::function<void(std::size_t)> task;
+    std::size_t next = 0;
+    std::size_t total = 0;
+    std::size_t active = 0;
+    std::exception_ptr error;
+    bool stop = false;
+};
+
+// Worker threads with a deque of tasks each. A thread runs tasks from the back of its own deque
+// and steals from the front of others when it is empty. Tasks spawned by a task go to the deque
+// of its thread, so a graph of tasks unfolds without barriers. The calling thread of run works too.
+class WorkStealingPool
+{
+public:
+    explicit WorkStealingPool(unsigned threads = std::thread::hardware_concurrency())
+        : queues(std::max(threads, 1u))
+    {
+        for (unsigned i = 1; i < queues.size(); ++i)
+            workers.emplace_back([this, i] { work(i); });
+    }
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    ~WorkStealingPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        wake.notify_all();
+        for (auto& worker : workers)
+            worker.join();
+    }
+
+    std::size_t size() const noexcept { return queues.size(); }
+
+    // Runs f and all tasks spawned while it runs, returns when all of them are finished.
+    // The first exception thrown by a task is rethrown. Tasks must not start another run.
+    template<typename F>
+    void run(F f)
+    {
+        std::lock_guard<std::mutex> run_lock(run_mutex);
+        auto previous = std::exchange(current, {this, 0});
+        spawn(std::move(f));
+        while (pending != 0) {
+            if (!try_run(0)) {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this] { return queued != 0 || pending == 0; });
+            }
+        }
+        current = previous;
+        if (error != nullptr)
+            std::rethrow_exception(std::exchange(error, nullptr));
+    }
+
+    // Adds a task to the run, tasks spawned by threads of other pools go to the deque of the calling thread of run
+    template<typename F>
+    void spawn(F f)
+    {
+        auto index = current.first == this ? current.second : 0;
+        ++pending;
+        {
+            std::lock_guard<std::mutex> lock(queues[index].mutex);
+            queues[index].tasks.emplace_back(std::move(f));
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++queued;
+        }
+        wake.notify_one();
+    }
+
+    // A round of independent tasks, so the pool serves as an executor of sort_parallel
+    template<typename F>
+    void for_each(std::size_t count, F f)
+    {
+        run([this, count, &f] {
+            for (std::size_t i = 0; i < count; ++i)
+                spawn([&f, i] { f(i); });
+        });
+    }
+
+private:
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    // Takes a task from the back of the own deque or from the front of another one
+    bool try_run(std::size_t index)
+    {
+        std::function<void()> task;
+        for (std::size_t i = 0; i < queues.size() && !task; ++i) {
+            auto& queue = queues[(index + i) % queues.size()];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.tasks.empty())
+                continue;
+            if (i == 0) {
+                task = std::move(queue.tasks.back());
+                queue.tasks.pop_back();
+            }
+            else {
+                task = std::move(queue.tasks.front());
+                queue.tasks.pop_front();
+            }
+        }
+        if (!task)
+            return false;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            --queued;
+        }
+        try {
+            task();
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (error == nullptr)
+                error = std::current_exception();
+        }
+        if (--pending == 0) {
+            std::lock_guard<std::mutex> lock(mutex);
+            wake.notify_all();
+        }
+        return true;
+    }
+
+    void work(std::size_t index)
+    {
+        current = {this, index};
+        while (true) {
+            if (try_run(index))
+                continue;
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this] { return stop || queued != 0; });
+            if (stop)
+                return;
+        }
+    }
+
+    // Pool and index of the deque of the running thread
+    static inline thread_local std::pair<const WorkStealingPool*, std::size_t> current = {nullptr, 0};
+
+    std::vector<Queue> queues;
+    std::vector<std::thread> workers;
+    std::mutex run_mutex;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::atomic<std::size_t> pending = 0;
+    std::size_t queued = 0;
+    std::exception_ptr error;
+    bool stop = false;
+};
+
+// Least number of elements worth a task of their own: smaller chunks, buckets
+// and merge segments cost more to schedule than to process in place
+static constexpr const std::size_t parallel_grain = 4096;
+
+// Memory resource for tasks of a pool which allocate simultaneously:
+// the resource of the caller is not required to be thread-safe
+inline std::pmr::synchronized_pool_resource shared_resource(std::pmr::memory_resource* upstream)
+{
+    return std::pmr::synchronized_pool_resource(upstream);
+}
+
+// Merges pairs of ranges at offsets from one space to the same offsets in another one.
+// Pairs go from the start, so the output is written in order.
+template<typename Compare, typename From, typename To, typename Bounds>
+void merge_level(Compare cmp, From from, To to, Bounds& bounds)
+{
+    // The first range has no pair if the number of ranges is odd
+    std::size_t i = 0;
+    if (bounds.size() % 2 == 0) {
+        std::move(from + bounds[0], from + bounds[1], to + bounds[0]);
+        i = 1;
+    }
+    for (; i + 2 < bounds.size(); i += 2)
+        move_merge(from + bounds[i], from + bounds[i + 1], from + bounds[i + 2], to + bounds[i], cmp);
+    join_bounds(bounds);
+}
+
+// Merge path: the number of elements of a among the first k elements of the stable merge of a and b
+template<typename It, typename Compare>
+std::size_t co_rank(std::size_t k, It a, std::size_t a_size, It b, std::size_t b_size, Compare cmp)
+{
+    std::size_t lo = k > b_size ? k - b_size : 0;
+    std::size_t hi = std::min(k, a_size);
+    while (lo < hi) {
+        // a[i] is among the first k if it goes before b[k - i - 1]
+        auto i = lo + (hi - lo) / 2;
+        if (!cmp(b[k - i - 1], a[i]))
+            lo = i + 1;
+        else
+            hi = i;
+    }
+    return lo;
+}
+
+// Part of a merge of two ranges given by offsets, the output starts at offset out
+struct MergeSegment
+{
+    std::size_t a;
+    std::size_t a_last;
+    std::size_t b;
+    std::size_t b_last;
+    std::size_t out;
+};
+
+// Splits the merge of adjacent ranges at offsets from base into parts making equal segments of the output.
+// Parts are found before any of them is merged, as merging moves elements out of the ranges.
+template<typename It, typename Compare, typename Segments>
+void split_merge(It base, std::size_t first, std::size_t middle, std::size_t last, std::size_t count, Compare cmp, Segments& segments)
+{
+    if (count <= 1) {
+        segments.push_back({first, middle, middle, last, first});
+        return;
+    }
+
+    std::size_t a_size = middle - first;
+    std::size_t b_size = last - middle;
+    std::size_t k = 0;
+    std::size_t i = 0;
+    for (std::size_t segment = 1; segment <= count; ++segment) {
+        auto next_k = (a_size + b_size) * segment / count;
+        auto next_i = co_rank(next_k, base + first, a_size, base + middle, b_size, cmp);
+        segments.push_back({first + i, first + next_i, middle + (k - i), middle + (next_k - next_i), first + k});
+        k = next_k;
+        i = next_i;
+    }
+}
+
+// Merges a part from one space to another one, whole pairs of adjacent ranges in order are moved at once.
+// If a comparison throws, the rest of the part is moved as it is, so the output gets all of its elements.
+template<typename From, typename To, typename Compare>
+void merge_segment(From from, To to, const MergeSegment& segment, Compare cmp)
+{
+    auto a = from + segment.a;
+    auto a_last = from + segment.a_last;
+    auto b = from + segment.b;
+    auto b_last = from + segment.b_last;
+    auto out = to + segment.out;
+    try {
+        if (a_last != b || (a != a_last && b != b_last && cmp(*b, *std::prev(b))))
+            merge_kernel_tracked(a, a_last, b, b_last, out, cmp);
+    }
+    catch (...) {
+        std::move(b, b_last, std::move(a, a_last, out));
+        throw;
+    }
+    std::move(b, b_last, std::move(a, a_last, out));
+}
+
+// Parallel version: pairs are tasks of a round of the pool, and pairs larger than
+// a share of a thread are split into segments by merge path, so the last rounds
+// which merge few large ranges load all threads too
+template<typename Compare, typename From, typename To, typename Bounds, typename Pool>
+void merge_level(Compare cmp, From from, To to, Bounds& bounds, Pool& pool)
+{
+    auto share = std::max((bounds.back() - bounds.front()) / pool.size() + 1, parallel_grain);
+
+    // The first range is merged with an empty one if it has no pair
+    std::pmr::vector<MergeSegment> segments(bounds.get_allocator().resource());
+    auto i = bounds.size() - 1;
+    for (; i >= 2; i -= 2)
+        split_merge(from, bounds[i - 2], bounds[i - 1], bounds[i], (bounds[i] - bounds[i - 2] + share - 1) / share, cmp, segments);
+    if (i == 1)
+        split_merge(from, bounds[0], bounds[1], bounds[1], (bounds[1] - bounds[0] + share - 1) / share, cmp, segments);
+
+    pool.for_each(segments.size(), [&](std::size_t s) { merge_segment(from, to, segments[s], cmp); });
+    join_bounds(bounds);
+}
+
+// Ping-pong merge: ranges at offsets from a are merged by rounds of merge,
+// each round streams all elements between spaces a and b which have the same size.
+// Returns true if the result is in b. Pool, if any, is passed to merge_level.
+template<typename Compare, typename A, typename B, typename Bounds, typename... Pool>
+bool merge_levels(Compare cmp, A a, B b, Bounds& bounds, Pool&... pool)
+{
+    if (bounds.size() <= 2)
+        return false;
+
+    merge_level(cmp, a, b, bounds, pool...);
+    return !merge_levels(cmp, b, a, bounds, pool...);
+}
+
+// The first round constructs elements in b, the next ones assign them
+template<typename Compare, typename A, typename T, typename Bounds, typename... Pool>
+bool merge_levels(Compare cmp, A a, ConstructIterator<T> b, Bounds& bounds, Pool&... pool)
+{
+    if (bounds.size() <= 2)
+        return false;
+
+    merge_level(cmp, a, b, bounds, pool...);
+    return !merge_levels(cmp, b.base(), a, bounds, pool...);
+}
+
+// Merge of adjacent ranges [first, middle) and [middle, last) given by offsets
+struct MergeStep
+{
+    std::size_t first;
+    std::size_t middle;
+    std::size_t last;
+};
+
+// Depth of the boundary between adjacent ranges in the powersort tree:
+// the first bit where binary fractions of their midpoints over the total size differ
+inline unsigned merge_power(std::size_t first, std::size_t middle, std::size_t last, std::size_t size) noexcept
+{
+    // Midpoints doubled, so they are integers: a / 2size and b / 2size
+    auto a = first + middle;
+    auto b = middle + last;
+    unsigned power = 0;
+    while (true) {
+        ++power;
+        // Compare the next binary digits of a / 2size and b / 2size
+        bool da = a >= size;
+        bool db = b >= size;
+        if (da != db)
+            return power;
+        if (da) {
+            a -= size;
+            b -= size;
+        }
+        a *= 2;
+        b *= 2;
+    }
+}
+
+// Plans merges of ranges with the powersort rule: neighbours are merged
+// in order of depth of their boundary, which depends on actual range sizes.
+// The total number of moved elements is within a small additive term of the optimal
+// tree merging neighbours only, and merging only neighbours keeps the order of equal elements.
+// Steps come in order of execution, each one after the steps producing its ranges.
+template<typename Bounds>
+std::pmr::vector<MergeStep> plan_merges(const Bounds& bounds, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+{
+    std::pmr::vector<MergeStep> steps(resource);
+    if (bounds.size() <= 2)
+        return steps;
+
+    steps.reserve(bounds.size() - 2);
+    std::size_t size = bounds.back() - bounds.front();
+    std::pmr::vector<std::pair<std::size_t, unsigned>> stack(resource); // first offset and power of ranges waiting for a merge
+    std::size_t first = bounds[0];
+    for (std::size_t i = 1; i + 1 < bounds.size(); ++i) {
+        auto power = merge_power(first - bounds.front(), bounds[i] - bounds.front(), bounds[i + 1] - bounds.front(), size);
+        while (!stack.empty() && stack.back().second > power) {
+            steps.push_back({stack.back().first, first, bounds[i]});
+            first = stack.back().first;
+            stack.pop_back();
+        }
+        stack.emplace_back(first, power);
+        first = bounds[i];
+    }
+    for (; !stack.empty(); stack.pop_back()) {
+        steps.push_back({stack.back().first, first, bounds.back()});
+        first = stack.back().first;
+    }
+
+    return steps;
+}
 
-template<typename Deck, typename Compare>
-class Installer
+// Executes planned merges in place moving shorter ranges to scratch
+template<typename Compare, typename It, typename Steps, typename T>
+void merge_planned(Compare cmp, It base, const Steps& steps, T* scratch)
 {
-    using T = typename Deck::value_type;
-public:
-    explicit Installer(Compare cmp) noexcept
-        : cmp(cmp)
-    { }
+    for (const auto& step : steps) {
+        std::pair<It, It> r1(base + step.first, base + step.middle);
+        std::pair<It, It> r2(base + step.middle, base + step.last);
+        merge_range(r1, r2, cmp, scratch);
+    }
+}
 
-    template<typename It>
-    auto install(It begin, It end)
-    {
-        for (auto it = begin; it != end; ++it)
-            get_deck_pointer(*it)->emplace_back(std::move(*it));
+// Index of the range starting at offset
+template<typename Bounds>
+std::size_t range_index(const Bounds& bounds, std::size_t offset)
+{
+    return std::distance(bounds.begin(), std::lower_bound(bounds.begin(), bounds.end(), offset));
+}
 
-        if constexpr (is_list<Deck>)
-            return std::move(decks);
-        else
-            return install_back(begin);
+// Same as above for iterators without arithmetic: points are iterators at bounds.
+// A merged range starts at the point of its first range, so points stay valid.
+template<typename Compare, typename Bounds, typename Points, typename Steps, typename T>
+void merge_planned(Compare cmp, const Bounds& bounds, const Points& points, const Steps& steps, T* scratch)
+{
+    using It = typename Points::value_type;
+    for (const auto& step : steps) {
+        auto middle = points[range_index(bounds, step.middle)];
+        std::pair<It, It> r1(points[range_index(bounds, step.first)], middle);
+        std::pair<It, It> r2(middle, points[range_index(bounds, step.last)]);
+        merge_range(r1, r2, cmp, scratch);
     }
+}
 
-    auto install(std::list<T>& list)
-    {
-        static_assert(is_list<Deck>);
-        for (auto it = list.begin(); it != list.end();) {
-            auto tmp = it++;
-            auto target = get_deck_pointer(*tmp);
-            target->splice(target->end(), list, tmp);
+// Merges list decks in the order planned by their sizes.
+// A merged list is kept in the deck of its first range.
+template<typename Compare, typename Decks>
+auto merge_planned(Compare cmp, Decks& decks, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+{
+    std::pmr::vector<std::size_t> bounds(resource);
+    bounds.reserve(decks.size() + 1);
+    bounds.push_back(0);
+    for (const auto& deck : decks)
+        bounds.push_back(bounds.back() + deck.size());
+
+    for (const auto& step : plan_merges(bounds, resource)) {
+        auto& l1 = decks[range_index(bounds, step.first)];
+        auto& l2 = decks[range_index(bounds, step.middle)];
+        merge_range(l1, l2, cmp);
+        l1.swap(l2);
+    }
+    return std::move(decks.front());
+}
+
+// Runs planned merges as a graph of tasks: a merge starts as soon as merges producing its ranges finish.
+// Each merge uses scratch at the offsets of its ranges, so scratch has the size of the data.
+// Merges larger than a share of a thread move their ranges to scratch and merge them back
+// in segments of the merge path, which are tasks too.
+template<typename Compare, typename It, typename Steps, typename T, typename Pool>
+void merge_tasks(Compare cmp, It base, const Steps& steps, T* scratch, Pool& pool, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+{
+    if (steps.empty())
+        return;
+
+    auto share = std::max((steps.back().last - steps.back().first) / pool.size() + 1, parallel_grain);
+    auto none = steps.size();
+
+    // Ranges are known by their first offsets, the latest step starting at an offset produced the range there
+    std::pmr::vector<std::size_t> parents(steps.size(), none, resource);
+    std::pmr::vector<std::atomic<std::size_t>> waiting(steps.size(), resource); // unfinished children, then unfinished segments
+    std::pmr::unordered_map<std::size_t, std::size_t> producers(resource);
+    for (std::size_t s = 0; s < steps.size(); ++s) {
+        for (auto offset : {steps[s].first, steps[s].middle}) {
+            auto producer = producers.find(offset);
+            if (producer != producers.end()) {
+                parents[producer->second] = s;
+                ++waiting[s];
+                producers.erase(producer);
+            }
         }
-        return std::move(decks);
+        producers[steps[s].first] = s;
     }
 
-private:
-    // Puts partially sorted data back to input
-    // Generates ranges of sorted data
-    template<typename It>
-    auto install_back(It begin) noexcept
-    {
-        std::deque<std::pair<It, It>> points;
-        auto end = begin;
-        for (auto& deck : decks) {
-            auto range_begin = end;
-            end = std::move(deck.begin(), deck.end(), range_begin);
-            points.emplace_back(range_begin, end);
+    // Steps split their merges simultaneously
+    auto shared = shared_resource(resource);
+    std::pmr::vector<std::pmr::vector<MergeSegment>> segments(steps.size(), &shared);
+
+    // Steps get the function running them, as a lambda cannot refer to itself
+    auto finish = [&](const auto& run_step, std::size_t s) {
+        auto parent = parents[s];
+        if (parent != none && --waiting[parent] == 0)
+            pool.spawn([&run_step, parent] { run_step(run_step, parent); });
+    };
+    auto run_step = [&](const auto& self, std::size_t s) -> void {
+        const auto& step = steps[s];
+        auto middle = base + step.middle;
+        if (step.last - step.first <= share || !cmp(*middle, *std::prev(middle))) {
+            std::pair<It, It> r1(base + step.first, middle);
+            std::pair<It, It> r2(middle, base + step.last);
+            merge_range(r1, r2, cmp, scratch + step.first);
+            finish(self, s);
+            return;
         }
-        return points;
+
+        split_merge(base, step.first, step.middle, step.last, (step.last - step.first + share - 1) / share, cmp, segments[s]);
+        std::uninitialized_move(base + step.first, base + step.last, scratch + step.first);
+        waiting[s] = segments[s].size();
+        for (const auto& segment : segments[s]) {
+            pool.spawn([&, s, segment] {
+                // The last segment destroys the scratch of the step, even if a comparison throws
+                auto last_segment = [&] {
+                    if (--waiting[s] != 0)
+                        return false;
+                    std::destroy(scratch + steps[s].first, scratch + steps[s].last);
+                    return true;
+                };
+                try {
+                    merge_segment(scratch, base, segment, cmp);
+                }
+                catch (...) {
+                    last_segment();
+                    throw;
+                }
+                if (last_segment())
+                    finish(self, s);
+            });
+        }
+    };
+
+    // Steps merging decks are found before any of them runs and makes its parent ready
+    std::pmr::vector<std::size_t> leaves(resource);
+    for (std::size_t s = 0; s < steps.size(); ++s)
+        if (waiting[s] == 0)
+            leaves.push_back(s);
+    pool.run([&] {
+        for (auto s : leaves)
+            pool.spawn([&run_step, s] { run_step(run_step, s); });
+    });
+}
+
+// Merges all ranges at offsets from base to out in a single pass.
+// A tournament tree keeps the range which lost the match at each node,
+// so the next element is found by log k matches on the path of the last winner.
+template<typename Compare, typename It, typename Bounds, typename Out>
+Out kway_merge(Compare cmp, It base, const Bounds& bounds, Out out, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+{
+    std::size_t k = bounds.size() - 1;
+    if (k <= 1)
+        return std::move(base + bounds.front(), base + bounds.back(), out);
+
+    std::pmr::vector<std::size_t> cursors(bounds.begin(), std::prev(bounds.end()), resource);
+
+    // Exhausted ranges lose, equal elements are taken from the leftmost range
+    auto beats = [&](std::size_t i, std::size_t j) {
+        if (cursors[i] == bounds[i + 1])
+            return false;
+        if (cursors[j] == bounds[j + 1])
+            return true;
+        return i < j ? !cmp(base[cursors[j]], base[cursors[i]]) : cmp(base[cursors[i]], base[cursors[j]]);
+    };
+
+    // Leaves are nodes k to 2k - 1, the parent of node n is n / 2
+    std::pmr::vector<std::size_t> winners(2 * k, resource);
+    std::pmr::vector<std::size_t> losers(k, resource);
+    for (std::size_t i = 0; i < k; ++i)
+        winners[k + i] = i;
+    for (std::size_t n = k - 1; n != 0; --n) {
+        auto lhs = winners[2 * n];
+        auto rhs = winners[2 * n + 1];
+        bool left = beats(lhs, rhs);
+        winners[n] = left ? lhs : rhs;
+        losers[n] = left ? rhs : lhs;
     }
 
-    auto get_deck_pointer(const T& val)
-    {
-        auto res = find_deck(val, decks.begin(), decks.end());
-        return res != decks.end() ? res : allocate_new_deck();
+    auto winner = winners[1];
+    for (auto count = bounds.back() - bounds.front(); count != 0; --count) {
+        *out++ = std::move(base[cursors[winner]++]);
+        for (auto n = (winner + k) / 2; n != 0; n /= 2)
+            if (beats(losers[n], winner))
+                std::swap(losers[n], winner);
     }
 
-    auto allocate_new_deck()
-    {
-        decks.resize(decks.size() + 1);
-        return decks.end() - 1;
+    return out;
+}
+
+// Sorts by keys produced by proj, which is applied once per element and per merge step.
+// All memory is taken from the resource, except for Deck types which bring their own allocator.
+template<typename Deck, template<typename, typename> typename Tops = BinaryTops, typename It, typename Compare, typename Proj>
+void sort_by(It begin, It end, Compare cmp, Proj proj, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+{
+    if (begin == end)
+        return;
+
+    using T = typename Deck::value_type;
+    std::size_t size = std::distance(begin, end);
+    auto element_cmp = project(cmp, proj);
+    if constexpr (is_counting<Deck>) {
+        // The input is the second space of the ping-pong merge
+        Buffer<T> buffer(size, resource);
+        std::pmr::vector<std::size_t> bounds(resource);
+        Installer<Deck, Compare, Tops, Proj>(cmp, proj, resource).scatter(begin, end, buffer.data(), bounds);
+        buffer.set_constructed(size);
+        if (!merge_levels(element_cmp, buffer.data(), begin, bounds))
+            std::move(buffer.data(), buffer.data() + size, begin);
+    }
+    else if constexpr (is_list<Deck>) {
+        auto decks = install<Deck, Tops>(begin, end, cmp, resource, proj);
+        auto range = merge_planned(element_cmp, decks, resource);
+        std::move(range.begin(), range.end(), begin);
+    }
+    else if constexpr (!is_random_access<It>) {
+        // Decks are collected back to the input, and merges are planned by their sizes
+        Installer<Deck, Compare, Tops, Proj> installer(cmp, proj, resource);
+        installer.deal(begin, end);
+        std::pmr::vector<std::size_t> bounds(resource);
+        std::pmr::vector<It> points(resource);
+        bounds.reserve(installer.size() + 1);
+        points.reserve(installer.size() + 1);
+        installer.collect(begin, bounds, points);
+        Buffer<T> scratch(size / 2 + 1, resource);
+        merge_planned(element_cmp, bounds, points, plan_merges(bounds, resource), scratch.data());
+    }
+    else {
+        // Decks are collected to the space where an even number of merge rounds starts,
+        // so the merged data ends up in the input
+        Installer<Deck, Compare, Tops, Proj> installer(cmp, proj, resource);
+        installer.deal(begin, end);
+        Buffer<T> aux(size, resource);
+        std::pmr::vector<std::size_t> bounds(resource);
+        bounds.reserve(installer.size() + 1);
+        auto depth = merge_depth(installer.size());
+        if (depth % 2 == 0) {
+            installer.collect(begin, bounds);
+            merge_levels(element_cmp, begin, aux.appender(), bounds);
+        }
+        else {
+            installer.collect(aux.appender(), bounds);
+            merge_levels(element_cmp, aux.data(), begin, bounds);
+        }
     }
+}
 
-    template<typename DeckIt>
-    auto find_deck(const T& val, DeckIt begin, DeckIt end) const noexcept
-    {
-        if (end == begin)
-            return begin;
+template<typename Deck, template<typename, typename> typename Tops = BinaryTops, typename It, typename Compare>
+void sort(It begin, It end, Compare cmp, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+{
+    sort_by<Deck, Tops>(begin, end, cmp, Identity(), resource);
+}
 
-        if (end == begin + 1)
-            return cmp(begin->back(), val) ? begin : end;
+template<template<typename, typename> typename Tops = BinaryTops, typename T, typename Allocator, typename Compare>
+void sort(std::list<T, Allocator>& list, Compare cmp, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+{
+    if (list.empty())
+        return;
 
-        auto mid = std::next(begin, std::distance(begin, end) / 2);
-        return cmp(mid->back(), val)
-            ? find_deck(val, begin, mid)
-            : find_deck(val, mid, end);
+    auto decks = install<std::list<T, Allocator>, Tops>(list, cmp, resource);
+    list = merge_planned(cmp, decks, resource);
+}
+
+// Copies elements into a buffer deck by deck and merges them there,
+// but the last merge writes to out. The input is only read, forward iterators are enough.
+template<template<typename, typename> typename Tops = BinaryTops, typename It, typename OutIt, typename Compare>
+OutIt sort_copy(It begin, It end, OutIt out, Compare cmp, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+{
+    using T = typename std::iterator_traits<It>::value_type;
+    std::size_t size = std::distance(begin, end);
+    if (size == 0)
+        return out;
+
+    Buffer<T> buffer(size, resource);
+    std::pmr::vector<std::size_t> bounds(resource);
+    Installer<Counting<T>, Compare, Tops>(cmp, resource).scatter_copy(begin, end, buffer.data(), bounds);
+    buffer.set_constructed(size);
+    auto data = buffer.data();
+    if (bounds.size() == 2)
+        return std::move(data, data + size, out);
+
+    auto steps = plan_merges(bounds, resource);
+    auto last = steps.back();
+    steps.pop_back();
+    Buffer<T> scratch(size / 2 + 1, resource);
+    merge_planned(cmp, data, steps, scratch.data());
+    return std::merge(std::make_move_iterator(data + last.first), std::make_move_iterator(data + last.middle),
+                      std::make_move_iterator(data + last.middle), std::make_move_iterator(data + last.last), out, cmp);
+}
+
+// Scatters decks to a buffer and merges all of them back to the input in one pass,
+// so each element is moved twice regardless of the number of decks
+template<template<typename, typename> typename Tops = BinaryTops, typename It, typename Compare>
+void sort_kway(It begin, It end, Compare cmp, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+{
+    using T = typename std::iterator_traits<It>::value_type;
+    std::size_t size = std::distance(begin, end);
+    if (size == 0)
+        return;
+
+    Buffer<T> buffer(size, resource);
+    std::pmr::vector<std::size_t> bounds(resource);
+    Installer<Counting<T>, Compare, Tops>(cmp, resource).scatter(begin, end, buffer.data(), bounds);
+    buffer.set_constructed(size);
+    kway_merge(cmp, buffer.data(), bounds, begin, resource);
+}
+
+// Splits the input into a chunk per thread of the pool, each chunk is dealt
+// by its own installer to its part of the buffer. Returns offsets of decks of all chunks:
+// chunks are in input order, so merging neighbouring decks keeps the order of equal elements.
+template<template<typename, typename> typename Tops = BinaryTops, typename It, typename Compare, typename Executor, typename T>
+std::pmr::vector<std::size_t> deal_chunks(It begin, It end, Compare cmp, Executor& pool, T* buffer, std::pmr::memory_resource* resource)
+{
+    std::size_t size = std::distance(begin, end);
+
+    // Installers allocate simultaneously
+    auto shared = shared_resource(resource);
+    std::size_t chunks = std::clamp<std::size_t>(size / parallel_grain, 1, pool.size());
+    std::pmr::vector<std::pmr::vector<std::size_t>> chunk_bounds(chunks, &shared);
+    pool.for_each(chunks, [&](std::size_t c) {
+        auto first = size * c / chunks;
+        auto last = size * (c + 1) / chunks;
+        Installer<Counting<T>, Compare, Tops>(cmp, &shared).scatter(begin + first, begin + last, buffer + first, chunk_bounds[c]);
+        for (auto& bound : chunk_bounds[c])
+            bound += first;
+    });
+
+    std::pmr::vector<std::size_t> bounds(1, 0, resource);
+    for (const auto& deck_bounds : chunk_bounds)
+        bounds.insert(bounds.end(), std::next(deck_bounds.begin()), deck_bounds.end());
+    return bounds;
+}
+
+// Deals chunks of the input in parallel to a buffer and merges decks back to the input by rounds,
+// pairs of ranges of each round are merged on threads of the pool
+template<template<typename, typename> typename Tops = BinaryTops, typename It, typename Compare, typename Executor>
+void sort_parallel(It begin, It end, Compare cmp, Executor& pool, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+{
+    using T = typename std::iterator_traits<It>::value_type;
+    std::size_t size = std::distance(begin, end);
+    if (size == 0)
+        return;
+
+    Buffer<T> buffer(size, resource);
+    auto bounds = deal_chunks<Tops>(begin, end, cmp, pool, buffer.data(), resource);
+    buffer.set_constructed(size);
+    if (!merge_levels(cmp, buffer.data(), begin, bounds, pool))
+        std::move(buffer.data(), buffer.data() + size, begin);
+}
+
+// Deals chunks of the input in parallel and moves decks back to the input,
+// where the powersort plan of merges runs as a graph of tasks with the buffer as scratch
+template<template<typename, typename> typename Tops = BinaryTops, typename It, typename Compare>
+void sort_tasks(It begin, It end, Compare cmp, WorkStealingPool& pool, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+{
+    using T = typename std::iterator_traits<It>::value_type;
+    std::size_t size = std::distance(begin, end);
+    if (size == 0)
+        return;
+
+    Buffer<T> buffer(size, resource);
+    auto bounds = deal_chunks<Tops>(begin, end, cmp, pool, buffer.data(), resource);
+    pool.for_each(pool.size(), [&](std::size_t part) {
+        auto first = buffer.data() + size * part / pool.size();
+        auto last = buffer.data() + size * (part + 1) / pool.size();
+        std::move(first, last, begin + (first - buffer.data()));
+        std::destroy(first, last);
+    });
+    merge_tasks(cmp, begin, plan_merges(bounds, resource), buffer.data(), pool, resource);
+}
+
+struct First
+{
+    template<typename Pair>
+    const auto& operator()(const Pair& pair) const noexcept { return pair.first; }
+};
+
+// Projects each element once, and sorts elements together with their keys
+template<typename It, typename Compare, typename Proj>
+void sort_projected(It begin, It end, Compare cmp, Proj proj)
+{
+    using T = typename std::iterator_traits<It>::value_type;
+    using Key = std::decay_t<std::invoke_result_t<Proj&, const T&>>;
+    std::vector<std::pair<Key, T>> decorated;
+    decorated.reserve(std::distance(begin, end));
+    for (auto it = begin; it != end; ++it) {
+        Key key = std::invoke(proj, *it);
+        decorated.emplace_back(std::move(key), std::move(*it));
+    }
+
+    sort_by<Counting<std::pair<Key, T>>>(decorated.begin(), decorated.end(), cmp, First());
+    for (auto& element : decorated)
+        *begin++ = std::move(element.second);
+}
+
+// Compares indices by the elements they point to
+template<typename It, typename Compare>
+struct IndexCompare
+{
+    template<typename Index>
+    bool operator()(Index lhs, Index rhs) const
+    {
+        return cmp(begin[lhs], begin[rhs]);
     }
 
-    std::deque<Deck> decks;
+    It begin;
     Compare cmp;
 };
 
-template<typename Deck, typename It, typename Compare>
-auto install(It begin, It end, Compare cmp) noexcept
+// Deals and merges indices, so elements are neither moved nor copied
+template<typename Index, typename It, typename Compare>
+std::vector<Index> argsort(It begin, It end, Compare cmp)
 {
-    return Installer<Deck, Compare>(cmp).install(begin, end);
+    static_assert(std::is_unsigned_v<Index>);
+    std::size_t size = std::distance(begin, end);
+    if (size != 0 && size - 1 > std::numeric_limits<Index>::max())
+        throw std::length_error("Patience::argsort: index type is too narrow");
+
+    std::vector<Index> permutation(size);
+    std::iota(permutation.begin(), permutation.end(), Index{0});
+    sort<Counting<Index>>(permutation.begin(), permutation.end(), IndexCompare<It, Compare>{begin, cmp});
+    return permutation;
 }
 
-template<typename Deck, typename List, typename Compare>
-auto install(List& list, Compare cmp) noexcept
+// Moves begin[permutation[i]] to begin[i] following cycles of the permutation,
+// which costs L + 1 moves per cycle of length L. The permutation is consumed.
+template<typename It, typename Index>
+void apply_permutation(It begin, std::vector<Index>& permutation)
 {
-    return Installer<Deck, Compare>(cmp).install(list);
+    for (std::size_t i = 0; i < permutation.size(); ++i) {
+        if (permutation[i] == i)
+            continue;
+
+        auto tmp = std::move(begin[i]);
+        std::size_t j = i;
+        for (std::size_t k = permutation[j]; k != i; k = permutation[j]) {
+            begin[j] = std::move(begin[k]);
+            permutation[j] = j;
+            j = k;
+        }
+        begin[j] = std::move(tmp);
+        permutation[j] = j;
+    }
 }
 
+// Sorts indices, then puts each element in place with at most 1.5 moves on average
 template<typename It, typename Compare>
-void merge_range(std::pair<It, It>& r1, std::pair<It, It>& r2, Compare cmp) noexcept
+void sort_indirect(It begin, It end, Compare cmp)
 {
-    std::inplace_merge(r1.first, r1.second, r2.second, cmp);
-    r2.first = r1.first;
+    if (static_cast<std::size_t>(std::distance(begin, end)) <= std::numeric_limits<std::uint32_t>::max()) {
+        auto permutation = argsort<std::uint32_t>(begin, end, cmp);
+        apply_permutation(begin, permutation);
+    }
+    else {
+        auto permutation = argsort<std::size_t>(begin, end, cmp);
+        apply_permutation(begin, permutation);
+    }
 }
 
-template<typename T, typename Compare>
-void merge_range(std::list<T>& l1, std::list<T>& l2, Compare cmp) noexcept
+// Splits the input into a bucket per thread of the pool by splitters taken from a sorted sample,
+// so buckets follow each other in sorted order and are sorted independently with no merge between them.
+// Each chunk of the input is partitioned by its own thread. Elements go to buckets in input order,
+// and equal elements go to the same bucket, so their order is kept.
+template<template<typename, typename> typename Tops = BinaryTops, typename It, typename Compare, typename Executor>
+void sort_buckets(It begin, It end, Compare cmp, Executor& pool, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
 {
-    l2.merge(std::move(l1), cmp);
+    using T = typename std::iterator_traits<It>::value_type;
+    static constexpr const std::size_t oversampling = 16;
+    std::size_t size = std::distance(begin, end);
+    std::size_t buckets = std::clamp<std::size_t>(size / parallel_grain, 1, std::min<std::size_t>(pool.size(), std::numeric_limits<std::uint32_t>::max()));
+    if (buckets == 1) {
+        sort<Counting<T>, Tops>(begin, end, cmp, resource);
+        return;
+    }
+
+    // Splitters are positions of evenly spaced elements of the sorted sample.
+    // The sample takes an element at a random position of each stride of the input,
+    // so input repeating with the period of strides does not give equal splitters.
+    std::pmr::vector<std::size_t> sample(buckets * oversampling, resource);
+    std::minstd_rand random(size);
+    for (std::size_t i = 0; i < sample.size(); ++i) {
+        auto first = i * size / sample.size();
+        auto last = (i + 1) * size / sample.size();
+        sample[i] = first + random() % (last - first);
+    }
+    std::sort(sample.begin(), sample.end(), IndexCompare<It, Compare>{begin, cmp});
+    std::pmr::vector<std::size_t> splitters(resource);
+    for (std::size_t b = 1; b < buckets; ++b)
+        splitters.push_back(sample[b * oversampling]);
+
+    // Bucket of each element and sizes of buckets in each chunk
+    std::pmr::vector<std::uint32_t> indices(size, resource);
+    std::pmr::vector<std::size_t> offsets(buckets * buckets, resource);
+    auto chunk = [&](std::size_t c) { return std::make_pair(size * c / buckets, size * (c + 1) / buckets); };
+    pool.for_each(buckets, [&](std::size_t c) {
+        auto [first, last] = chunk(c);
+        for (auto i = first; i < last; ++i) {
+            auto bucket = std::upper_bound(splitters.begin(), splitters.end(), i,
+                [&](std::size_t lhs, std::size_t rhs) { return cmp(begin[lhs], begin[rhs]); }) - splitters.begin();
+            indices[i] = bucket;
+            ++offsets[bucket * buckets + c];
+        }
+    });
+
+    // Offset of each bucket of each chunk in the buffer: buckets go in order, chunks of a bucket too
+    std::exclusive_scan(offsets.begin(), offsets.end(), offsets.begin(), std::size_t{0});
+    std::pmr::vector<std::size_t> bounds(buckets + 1, size, resource);
+    for (std::size_t b = 0; b < buckets; ++b)
+        bounds[b] = offsets[b * buckets];
+
+    Buffer<T> buffer(size, resource);
+    pool.for_each(buckets, [&](std::size_t c) {
+        auto [first, last] = chunk(c);
+        for (auto i = first; i < last; ++i)
+            new (buffer.data() + offsets[indices[i] * buckets + c]++) T(std::move(begin[i]));
+    });
+    buffer.set_constructed(size);
+
+    // Sorts allocate simultaneously
+    auto shared = shared_resource(resource);
+    pool.for_each(buckets, [&](std::size_t b) {
+        auto first = buffer.data() + bounds[b];
+        auto last = buffer.data() + bounds[b + 1];
+        auto out = begin + bounds[b];
+        std::move(first, last, out);
+        sort<Counting<T>, Tops>(out, begin + bounds[b + 1], cmp, &shared);
+    });
 }
 
-template<typename Compare, typename R>
-auto merge(Compare cmp, R&& ranges) noexcept
+// Sorts random access ranges keeping all buffers between calls,
+// so sorting data of the same or smaller size does not allocate memory.
+template<typename T, typename Compare = std::less<T>, template<typename, typename> typename Tops = BinaryTops>
+class Sorter
 {
-    // Everything is merged.
-    if (ranges.size() == 1)
-        return ranges.front();
+public:
+    explicit Sorter(Compare cmp = Compare(), std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : installer(cmp, resource)
+        , bounds(resource)
+        , buffer(resource)
+        , cmp(cmp)
+    { }
+
+    // Scratch memory size which is enough to sort size elements with BinaryTops,
+    // including a kilobyte for bookkeeping of containers
+    static constexpr std::size_t scratch_size(std::size_t size) noexcept
+    {
+        return size * sizeof(T)
+            + size * sizeof(typename Installer<Counting<T>, Compare, Tops>::TopKey)
+            + (size * 3 + 2) * sizeof(std::size_t)
+            + 1024;
+    }
 
-    R new_ranges;
+    void reserve(std::size_t size)
+    {
+        installer.reserve(size);
+        bounds.reserve(size + 1);
+        buffer.reserve(size);
+    }
 
-    // Usually last decks are the smallest, so merge them first
-    for (int i = ranges.size() - 1; i >= 0; i -= 2) {
-        if (i != 0)
-            merge_range(ranges[i - 1], ranges[i], cmp);
+    template<typename It>
+    void sort(It begin, It end)
+    {
+        auto size = std::distance(begin, end);
+        if (size == 0)
+            return;
 
-        new_ranges.emplace_front(std::move(ranges[i]));
+        reserve(size);
+        installer.clear();
+        installer.scatter(begin, end, buffer.data(), bounds);
+        buffer.set_constructed(size);
+        if (!merge_levels(cmp, buffer.data(), begin, bounds))
+            std::move(buffer.data(), buffer.data() + size, begin);
+        buffer.clear();
     }
 
-    return merge(cmp, std::move(new_ranges));
+private:
+    Installer<Counting<T>, Compare, Tops> installer;
+    std::pmr::vector<std::size_t> bounds;
+    Buffer<T> buffer;
+    Compare cmp;
+};
+
+} // namespace Patience
+
+template<template<typename, typename> typename Tops = Patience::BinaryTops, typename It>
+auto patience_sort_cont(It begin, It end)
+{
+    using T = typename It::value_type;
+    Patience::sort<std::deque<T>, Tops>(begin, end, std::less<T>());
 }
 
-template<typename Deck, typename It, typename Compare>
-void sort(It begin, It end, Compare cmp)
+template<template<typename, typename> typename Tops = Patience::BinaryTops, typename It, typename Compare>
+auto patience_sort_cont(It begin, It end, Compare cmp)
 {
-    auto ranges = install<Deck>(begin, end, cmp);
-    auto range = merge(cmp, std::move(ranges));
-    if constexpr (is_list<Deck>)
-        std::move(range.begin(), range.end(), begin);
+    using T = typename It::value_type;
+    Patience::sort<std::deque<T>, Tops>(begin, end, cmp);
 }
 
-template<typename T, typename Compare>
-void sort(std::list<T>& list, Compare cmp)
+template<template<typename, typename> typename Tops = Patience::BinaryTops, typename It, typename Compare>
+auto patience_sort_cont(It begin, It end, Compare cmp, std::pmr::memory_resource* resource)
 {
-    auto ranges = install<std::list<T>>(list, cmp);
-    list = merge(cmp, std::move(ranges));
+    using T = typename It::value_type;
+    Patience::sort<std::pmr::deque<T>, Tops>(begin, end, cmp, resource);
 }
 
-} // namespace Patience
+// Sorts with a caller-provided scratch memory, see Patience::Sorter::scratch_size.
+// No other memory is allocated: std::bad_alloc is thrown if the scratch is too short.
+template<template<typename, typename> typename Tops = Patience::BinaryTops, typename It, typename Compare>
+auto patience_sort_cont(It begin, It end, Compare cmp, std::byte* scratch, std::size_t size)
+{
+    using T = typename It::value_type;
+    std::pmr::monotonic_buffer_resource resource(scratch, size, std::pmr::null_memory_resource());
+    Patience::Sorter<T, Compare, Tops>(cmp, &resource).sort(begin, end);
+}
 
-template<typename It>
-auto patience_sort_cont(It begin, It end)
+template<template<typename, typename> typename Tops = Patience::BinaryTops, typename It>
+auto patience_sort_arena(It begin, It end)
 {
     using T = typename It::value_type;
-    Patience::sort<std::deque<T>>(begin, end, std::less<T>());
+    Patience::sort<Patience::ArenaDeck<T>, Tops>(begin, end, std::less<T>());
 }
 
-template<typename It, typename Compare>
-auto patience_sort_cont(It begin, It end, Compare cmp)
+template<template<typename, typename> typename Tops = Patience::BinaryTops, typename It, typename Compare>
+auto patience_sort_arena(It begin, It end, Compare cmp)
 {
     using T = typename It::value_type;
-    Patience::sort<std::deque<T>>(begin, end, cmp);
+    Patience::sort<Patience::ArenaDeck<T>, Tops>(begin, end, cmp);
 }
 
-template<typename It>
+template<template<typename, typename> typename Tops = Patience::BinaryTops, typename It, typename Compare>
+auto patience_sort_arena(It begin, It end, Compare cmp, std::pmr::memory_resource* resource)
+{
+    using T = typename It::value_type;
+    Patience::sort<Patience::ArenaDeck<T>, Tops>(begin, end, cmp, resource);
+}
+
+template<template<typename, typename> typename Tops = Patience::BinaryTops, typename It>
+auto patience_sort_scatter(It begin, It end)
+{
+    using T = typename It::value_type;
+    Patience::sort<Patience::Counting<T>, Tops>(begin, end, std::less<T>());
+}
+
+template<template<typename, typename> typename Tops = Patience::BinaryTops, typename It, typename Compare>
+auto patience_sort_scatter(It begin, It end, Compare cmp)
+{
+    using T = typename It::value_type;
+    Patience::sort<Patience::Counting<T>, Tops>(begin, end, cmp);
+}
+
+template<template<typename, typename> typename Tops = Patience::BinaryTops, typename It, typename Compare>
+auto patience_sort_scatter(It begin, It end, Compare cmp, std::pmr::memory_resource* resource)
+{
+    using T = typename It::value_type;
+    Patience::sort<Patience::Counting<T>, Tops>(begin, end, cmp, resource);
+}
+
+template<template<typename, typename> typename Tops = Patience::BinaryTops, typename It>
+auto patience_sort_kway(It begin, It end)
+{
+    using T = typename It::value_type;
+    Patience::sort_kway<Tops>(begin, end, std::less<T>());
+}
+
+template<template<typename, typename> typename Tops = Patience::BinaryTops, typename It, typename Compare>
+auto patience_sort_kway(It begin, It end, Compare cmp)
+{
+    Patience::sort_kway<Tops>(begin, end, cmp);
+}
+
+template<template<typename, typename> typename Tops = Patience::BinaryTops, typename It, typename Compare>
+auto patience_sort_kway(It begin, It end, Compare cmp, std::pmr::memory_resource* resource)
+{
+    Patience::sort_kway<Tops>(begin, end, cmp, resource);
+}
+
+template<template<typename, typename> typename Tops = Patience::BinaryTops, typename It>
 auto patience_sort_list(It begin, It end)
 {
     using T = typename It::value_type;
-    Patience::sort<std::list<T>>(begin, end, std::less<T>());
+    Patience::sort<std::list<T>, Tops>(begin, end, std::less<T>());
 }
 
-template<typename It, typename Compare>
+template<template<typename, typename> typename Tops = Patience::BinaryTops, typename It, typename Compare>
 auto patience_sort_list(It begin, It end, Compare cmp)
 {
     using T = typename It::value_type;
-    Patience::sort<std::list<T>>(begin, end, cmp);
+    Patience::sort<std::list<T>, Tops>(begin, end, cmp);
+}
+
+template<template<typename, typename> typename Tops = Patience::BinaryTops, typename It, typename Compare>
+auto patience_sort_list(It begin, It end, Compare cmp, std::pmr::memory_resource* resource)
+{
+    using T = typename It::value_type;
+    Patience::sort<std::pmr::list<T>, Tops>(begin, end, cmp, resource);
 }
 
 template<typename List, typename Compare>
@@ -207,6 +2821,158 @@ auto patience_sort(List& list, Compare cmp)
     Patience::sort(list, cmp);
 }
 
+template<typename List, typename Compare>
+auto patience_sort(List& list, Compare cmp, std::pmr::memory_resource* resource)
+{
+    Patience::sort(list, cmp, resource);
+}
+
+// Sorts by cmp(proj(a), proj(b)), computing proj once per element
+template<typename It, typename Compare, typename Proj>
+auto patience_sort(It begin, It end, Compare cmp, Proj proj)
+{
+    Patience::sort_projected(begin, end, cmp, proj);
+}
+
+// Returns indices of elements in sorted order, elements are not modified
+template<typename Index = std::size_t, typename It>
+auto patience_argsort(It begin, It end)
+{
+    using T = typename It::value_type;
+    return Patience::argsort<Index>(begin, end, std::less<T>());
+}
+
+template<typename Index = std::size_t, typename It, typename Compare>
+auto patience_argsort(It begin, It end, Compare cmp)
+{
+    return Patience::argsort<Index>(begin, end, cmp);
+}
+
+// Writes sorted copy of [begin, end) to out, returns the end of the output.
+// The input may be a forward range, such as a list.
+template<template<typename, typename> typename Tops = Patience::BinaryTops, typename It, typename OutIt>
+auto patience_sort_copy(It begin, It end, OutIt out)
+{
+    using T = typename std::iterator_traits<It>::value_type;
+    return Patience::sort_copy<Tops>(begin, end, out, std::less<T>());
+}
+
+template<template<typename, typename> typename Tops = Patience::BinaryTops, typename It, typename OutIt, typename Compare>
+auto patience_sort_copy(It begin, It end, OutIt out, Compare cmp)
+{
+    return Patience::sort_copy<Tops>(begin, end, out, cmp);
+}
+
+template<template<typename, typename> typename Tops = Patience::BinaryTops, typename It, typename OutIt, typename Compare>
+auto patience_sort_copy(It begin, It end, OutIt out, Compare cmp, std::pmr::memory_resource* resource)
+{
+    return Patience::sort_copy<Tops>(begin, end, out, cmp, resource);
+}
+
+// Sorts elements which are expensive to move
+template<typename It>
+auto patience_sort_indirect(It begin, It end)
+{
+    using T = typename It::value_type;
+    Patience::sort_indirect(begin, end, std::less<T>());
+}
+
+template<typename It, typename Compare>
+auto patience_sort_indirect(It begin, It end, Compare cmp)
+{
+    Patience::sort_indirect(begin, end, cmp);
+}
+
+// Deals and merges on all hardware threads
+template<template<typename, typename> typename Tops = Patience::BinaryTops, typename It>
+auto patience_sort_parallel(It begin, It end)
+{
+    using T = typename It::value_type;
+    Patience::ThreadPool pool;
+    Patience::sort_parallel<Tops>(begin, end, std::less<T>(), pool);
+}
+
+template<template<typename, typename> typename Tops = Patience::BinaryTops, typename It, typename Compare>
+auto patience_sort_parallel(It begin, It end, Compare cmp)
+{
+    Patience::ThreadPool pool;
+    Patience::sort_parallel<Tops>(begin, end, cmp, pool);
+}
+
+// Partitions the input into buckets sorted on all hardware threads, see Patience::sort_buckets
+template<template<typename, typename> typename Tops = Patience::BinaryTops, typename It>
+auto patience_sort_buckets(It begin, It end)
+{
+    using T = typename It::value_type;
+    Patience::ThreadPool pool;
+    Patience::sort_buckets<Tops>(begin, end, std::less<T>(), pool);
+}
+
+template<template<typename, typename> typename Tops = Patience::BinaryTops, typename It, typename Compare>
+auto patience_sort_buckets(It begin, It end, Compare cmp)
+{
+    Patience::ThreadPool pool;
+    Patience::sort_buckets<Tops>(begin, end, cmp, pool);
+}
+
+template<template<typename, typename> typename Tops = Patience::BinaryTops, typename It, typename Compare, typename Executor>
+auto patience_sort_buckets(It begin, It end, Compare cmp, Executor& executor)
+{
+    Patience::sort_buckets<Tops>(begin, end, cmp, executor);
+}
+
+// Merges without barriers between rounds on a work-stealing pool
+template<template<typename, typename> typename Tops = Patience::BinaryTops, typename It>
+auto patience_sort_tasks(It begin, It end)
+{
+    using T = typename It::value_type;
+    Patience::WorkStealingPool pool;
+    Patience::sort_tasks<Tops>(begin, end, std::less<T>(), pool);
+}
+
+template<template<typename, typename> typename Tops = Patience::BinaryTops, typename It, typename Compare>
+auto patience_sort_tasks(It begin, It end, Compare cmp)
+{
+    Patience::WorkStealingPool pool;
+    Patience::sort_tasks<Tops>(begin, end, cmp, pool);
+}
+
+template<template<typename, typename> typename Tops = Patience::BinaryTops, typename It, typename Compare>
+auto patience_sort_tasks(It begin, It end, Compare cmp, Patience::WorkStealingPool& pool)
+{
+    Patience::sort_tasks<Tops>(begin, end, cmp, pool);
+}
+
+// Runs on a caller's executor, see Patience::ThreadPool
+template<template<typename, typename> typename Tops = Patience::BinaryTops, typename It, typename Compare, typename Executor>
+auto patience_sort_parallel(It begin, It end, Compare cmp, Executor& executor)
+{
+    Patience::sort_parallel<Tops>(begin, end, cmp, executor);
+}
+
+// Overloads taking standard execution policies are declared if <execution> is included before this header.
+// Parallel policies deal and merge on all hardware threads, other ones sort on the calling thread.
+#ifdef __cpp_lib_execution
+#include <execution>
+
+template<typename Policy, typename It, typename Compare, typename = std::enable_if_t<std::is_execution_policy_v<std::decay_t<Policy>>>>
+auto patience_sort(Policy&&, It begin, It end, Compare cmp)
+{
+    using P = std::decay_t<Policy>;
+    if constexpr (std::is_same_v<P, std::execution::parallel_policy> || std::is_same_v<P, std::execution::parallel_unsequenced_policy>)
+        patience_sort_parallel(begin, end, cmp);
+    else
+        patience_sort_cont(begin, end, cmp);
+}
+
+template<typename Policy, typename It, typename = std::enable_if_t<std::is_execution_policy_v<std::decay_t<Policy>>>>
+auto patience_sort(Policy&& policy, It begin, It end)
+{
+    using T = typename It::value_type;
+    patience_sort(std::forward<Policy>(policy), begin, end, std::less<T>());
+}
+#endif
+
 template<typename List>
 auto patience_sort(List& list)
 {
@@ -22,13 +22,44 @@
  * SOFTWARE.
  */
 
+// Overloads for standard execution policies are declared if <execution> comes first
+#if __has_include(<execution>)
+#include <execution>
+#endif
+
 #include "patience_sort.h"
 
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
 #include <iostream>
 #include <list>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
 static bool compare(int a, int b) noexcept { return a > b; }
 
+static std::atomic<std::size_t> heap_allocations = 0;
+
+void* operator new(std::size_t size)
+{
+    ++heap_allocations;
+    if (void* ptr = std::malloc(size != 0 ? size : 1))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+[[gnu::noinline]] void operator delete(void* ptr) noexcept { std::free(ptr); }
+[[gnu::noinline]] void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+
 static bool check_cont()
 {
     std::list<int> example{1, 5, 1, 5, 12, 4, 104, 15, 2, 8};
@@ -61,9 +92,827 @@ static bool check_list_inplace()
     return std::is_sorted(example.begin(), example.end(), compare);
 }
 
+static std::vector<int> random_vector(std::size_t size)
+{
+    std::mt19937 gen(size);
+    std::uniform_int_distribution<int> dist(0, size / 2);
+    std::vector<int> result(size);
+    for (auto& x : result)
+        x = dist(gen);
+    return result;
+}
+
+static bool check_pmr_list()
+{
+    std::pmr::monotonic_buffer_resource resource;
+    std::pmr::list<int> small({5, 3, 9}, &resource);
+    patience_sort(small, std::less<int>());
+    if (!std::is_sorted(small.begin(), small.end()))
+        return false;
+
+    // Nodes are relinked, not reallocated by decks of another resource
+    auto example = random_vector(1000);
+    std::pmr::list<int> list(example.begin(), example.end(), &resource);
+    std::vector<const int*> nodes;
+    for (const auto& x : list)
+        nodes.push_back(&x);
+    patience_sort(list, compare);
+    std::vector<const int*> sorted_nodes;
+    for (const auto& x : list)
+        sorted_nodes.push_back(&x);
+    std::sort(nodes.begin(), nodes.end());
+    std::sort(sorted_nodes.begin(), sorted_nodes.end());
+
+    return std::is_sorted(list.begin(), list.end(), compare) && list.get_allocator().resource() == &resource
+        && nodes == sorted_nodes;
+}
+
+static bool check_many_decks()
+{
+    auto example = random_vector(10000);
+    patience_sort_cont(example.begin(), example.end());
+
+    return std::is_sorted(example.begin(), example.end());
+}
+
+static bool check_eytzinger()
+{
+    for (std::size_t size : {0, 1, 2, 3, 7, 8, 100, 10000}) {
+        auto example = random_vector(size);
+        patience_sort_cont<Patience::EytzingerTops>(example.begin(), example.end());
+        if (!std::is_sorted(example.begin(), example.end()))
+            return false;
+    }
+
+    std::vector<int> reverse(5000);
+    std::iota(reverse.rbegin(), reverse.rend(), 0);
+    patience_sort_cont<Patience::EytzingerTops>(reverse.begin(), reverse.end(), compare);
+    return std::is_sorted(reverse.begin(), reverse.end(), compare);
+}
+
+template<typename T, typename Compare>
+static bool check_keys(Compare cmp)
+{
+    auto values = random_vector(3000);
+    std::vector<T> example(values.begin(), values.end());
+    patience_sort_cont(example.begin(), example.end(), cmp);
+
+    return std::is_sorted(example.begin(), example.end(), cmp);
+}
+
+static bool check_vector_keys()
+{
+    return check_keys<std::int32_t>(std::less<std::int32_t>())
+        && check_keys<std::int64_t>(std::greater<std::int64_t>())
+        && check_keys<float>(std::less<>())
+        && check_keys<double>(std::greater<>());
+}
+
+static bool check_move_only()
+{
+    auto cmp = [](const std::unique_ptr<int>& a, const std::unique_ptr<int>& b) { return *a < *b; };
+    std::vector<std::unique_ptr<int>> example;
+    for (auto x : random_vector(3000))
+        example.push_back(std::make_unique<int>(x));
+    patience_sort_cont(example.begin(), example.end(), cmp);
+    if (!std::is_sorted(example.begin(), example.end(), cmp))
+        return false;
+
+    std::list<std::unique_ptr<int>> list;
+    for (auto x : random_vector(3000))
+        list.push_back(std::make_unique<int>(x));
+    patience_sort(list, cmp);
+
+    return std::is_sorted(list.begin(), list.end(), cmp);
+}
+
+static bool check_runs()
+{
+    std::vector<int> example(5000);
+    std::iota(example.begin(), example.end(), 0);
+    for (std::size_t i = 0; i + 3 < example.size(); i += 7)
+        std::swap(example[i], example[i + 3]);
+    std::list<int> list(example.begin(), example.end());
+
+    patience_sort_cont(example.begin(), example.end());
+    patience_sort(list);
+
+    return std::is_sorted(example.begin(), example.end())
+        && std::is_sorted(list.begin(), list.end());
+}
+
+static bool check_adaptive()
+{
+    for (std::size_t size : {0, 1, 10, 100, 30000}) {
+        auto example = random_vector(size);
+        patience_sort_cont<Patience::AdaptiveTops>(example.begin(), example.end());
+        if (!std::is_sorted(example.begin(), example.end()))
+            return false;
+    }
+
+    // Over 4096 decks for the exponential search
+    std::vector<int> example(20000);
+    for (std::size_t i = 0; i < example.size(); ++i)
+        example[i] = (example.size() - i) * 4 + i % 7;
+    patience_sort_cont<Patience::AdaptiveTops>(example.begin(), example.end(), compare);
+    return std::is_sorted(example.begin(), example.end(), compare);
+}
+
+static bool check_arena()
+{
+    std::list<int> example{1, 5, 1, 5, 12, 4, 104, 15, 2, 8};
+    patience_sort_arena(example.begin(), example.end());
+    if (!std::is_sorted(example.begin(), example.end()))
+        return false;
+
+    std::vector<std::string> strings;
+    for (int x : random_vector(10000))
+        strings.push_back(std::to_string(x));
+    patience_sort_arena(strings.begin(), strings.end(), std::greater<std::string>());
+    if (!std::is_sorted(strings.begin(), strings.end(), std::greater<std::string>()))
+        return false;
+
+    std::vector<int> reverse(100000);
+    std::iota(reverse.rbegin(), reverse.rend(), 0);
+    patience_sort_arena(reverse.begin(), reverse.end());
+    return std::is_sorted(reverse.begin(), reverse.end());
+}
+
+static bool check_scatter()
+{
+    for (std::size_t size : {1, 2, 10, 10000}) {
+        auto example = random_vector(size);
+        patience_sort_scatter(example.begin(), example.end(), compare);
+        if (!std::is_sorted(example.begin(), example.end(), compare))
+            return false;
+    }
+
+    std::vector<std::string> strings;
+    for (int x : random_vector(1000))
+        strings.push_back(std::to_string(x));
+    patience_sort_scatter(strings.begin(), strings.end());
+    return std::is_sorted(strings.begin(), strings.end());
+}
+
+// One byte element which is not trivially copyable, so deck tops point to it
+struct Tiny
+{
+    explicit Tiny(int key) : key(static_cast<unsigned char>(key)) { }
+    Tiny(const Tiny& rhs) : key(rhs.key) { }
+    Tiny& operator=(const Tiny&) = default;
+    bool operator<(const Tiny& rhs) const { return key < rhs.key; }
+
+    unsigned char key;
+};
+
+static bool check_sorter()
+{
+    Patience::Sorter<int, decltype(&compare)> sorter(compare);
+    for (std::size_t size : {1000, 10, 0, 1000, 3000}) {
+        auto example = random_vector(size);
+        sorter.sort(example.begin(), example.end());
+        if (!std::is_sorted(example.begin(), example.end(), compare))
+            return false;
+    }
+
+    // Scratch is enough to sort without other memory
+    using StringSorter = Patience::Sorter<std::string>;
+    std::vector<std::string> strings;
+    for (int x : random_vector(2000))
+        strings.push_back(std::to_string(x));
+    std::vector<std::byte> scratch(StringSorter::scratch_size(strings.size()));
+    std::pmr::monotonic_buffer_resource resource(scratch.data(), scratch.size(), std::pmr::null_memory_resource());
+    StringSorter(std::less<std::string>(), &resource).sort(strings.begin(), strings.end());
+    if (!std::is_sorted(strings.begin(), strings.end()))
+        return false;
+
+    auto example = random_vector(500);
+    std::size_t allocations = heap_allocations;
+    patience_sort_cont(example.begin(), example.end(), std::less<int>(), scratch.data(), scratch.size());
+    if (heap_allocations != allocations || !std::is_sorted(example.begin(), example.end()))
+        return false;
+
+    // Short scratch is not extended from the heap
+    try {
+        patience_sort_cont(strings.begin(), strings.end(), std::greater<std::string>(), scratch.data(), 64);
+        return false;
+    }
+    catch (const std::bad_alloc&) { }
+
+    // Scratch counts deck tops of their own type
+    for (std::size_t size : {100, 1000, 100000}) {
+        std::vector<Tiny> tiny;
+        for (int x : random_vector(size))
+            tiny.emplace_back(x);
+        std::vector<std::byte> tiny_scratch(Patience::Sorter<Tiny>::scratch_size(size));
+        patience_sort_cont(tiny.begin(), tiny.end(), std::less<Tiny>(), tiny_scratch.data(), tiny_scratch.size());
+        if (!std::is_sorted(tiny.begin(), tiny.end()))
+            return false;
+    }
+    return true;
+}
+
+template<typename Sort>
+static bool check_resource_with(Sort sort)
+{
+    auto example = random_vector(3000);
+    std::list<int> list(example.begin(), example.end());
+    std::vector<std::byte> memory(1 << 20);
+    std::pmr::monotonic_buffer_resource resource(memory.data(), memory.size(), std::pmr::null_memory_resource());
+
+    std::size_t allocations = heap_allocations;
+    sort(example.begin(), example.end(), &resource);
+    sort(list.begin(), list.end(), &resource);
+    if (heap_allocations != allocations)
+        return false;
+
+    return std::is_sorted(example.begin(), example.end(), compare)
+        && std::is_sorted(list.begin(), list.end(), compare);
+}
+
+static bool check_resource()
+{
+    return check_resource_with([](auto begin, auto end, auto resource) { patience_sort_cont(begin, end, compare, resource); })
+        && check_resource_with([](auto begin, auto end, auto resource) { patience_sort_list(begin, end, compare, resource); })
+        && check_resource_with([](auto begin, auto end, auto resource) { patience_sort_arena(begin, end, compare, resource); })
+        && check_resource_with([](auto begin, auto end, auto resource) {
+            if constexpr (std::is_same_v<decltype(begin), std::vector<int>::iterator>)
+                patience_sort_scatter(begin, end, compare, resource);
+            else
+                patience_sort_cont(begin, end, compare, resource);
+        });
+}
+
+struct Record
+{
+    int id;
+    std::string payload;
+};
+
+static bool check_projection()
+{
+    std::vector<Record> records;
+    for (int x : random_vector(2000))
+        records.push_back({x, std::to_string(x)});
+
+    std::size_t projections = 0;
+    patience_sort(records.begin(), records.end(), std::greater<int>(), [&](const Record& r) {
+        ++projections;
+        return r.id;
+    });
+    if (projections != records.size())
+        return false;
+    if (!std::is_sorted(records.begin(), records.end(), [](const auto& a, const auto& b) { return a.id > b.id; }))
+        return false;
+
+    patience_sort(records.begin(), records.end(), std::less<std::string>(), &Record::payload);
+    return std::is_sorted(records.begin(), records.end(), [](const auto& a, const auto& b) { return a.payload < b.payload; });
+}
+
+static bool check_argsort()
+{
+    const auto example = random_vector(3000);
+    auto permutation = patience_argsort(example.begin(), example.end(), compare);
+    auto narrow = patience_argsort<std::uint32_t>(example.begin(), example.end());
+    if (permutation.size() != example.size() || narrow.size() != example.size())
+        return false;
+
+    auto sorted = permutation;
+    std::sort(sorted.begin(), sorted.end());
+    for (std::size_t i = 0; i < sorted.size(); ++i)
+        if (sorted[i] != i)
+            return false;
+
+    for (std::size_t i = 1; i < permutation.size(); ++i)
+        if (compare(example[permutation[i]], example[permutation[i - 1]])
+            || example[narrow[i]] < example[narrow[i - 1]])
+            return false;
+
+    return true;
+}
+
+struct Heavy
+{
+    static std::size_t moves;
+
+    explicit Heavy(int key) : key(key) { }
+    Heavy(Heavy&& rhs) noexcept : key(rhs.key) { ++moves; }
+    Heavy& operator=(Heavy&& rhs) noexcept { key = rhs.key; ++moves; return *this; }
+
+    bool operator<(const Heavy& rhs) const noexcept { return key < rhs.key; }
+
+    int key;
+    char payload[256] = {};
+};
+
+std::size_t Heavy::moves = 0;
+
+static bool check_indirect()
+{
+    std::vector<Heavy> example;
+    for (int x : random_vector(3000))
+        example.emplace_back(x);
+
+    Heavy::moves = 0;
+    patience_sort_indirect(example.begin(), example.end());
+    return Heavy::moves <= example.size() * 3 / 2
+        && std::is_sorted(example.begin(), example.end());
+}
+
+// One large deck and an odd number of single elements: pairwise rounds would
+// merge the large deck in each round, while planned merges move it once
+static bool check_planned()
+{
+    std::list<Heavy> example;
+    for (int x = 1000; x < 5000; ++x)
+        example.emplace_back(x);
+    for (int x = 999; x > 936; --x)
+        example.emplace_back(x);
+
+    Heavy::moves = 0;
+    patience_sort_cont(example.begin(), example.end());
+    return Heavy::moves <= example.size() * 6
+        && std::is_sorted(example.begin(), example.end());
+}
+
+static bool check_copy()
+{
+    for (std::size_t size : {0, 1, 2, 3, 100, 3000}) {
+        const auto example = random_vector(size);
+        const auto original = example;
+        std::vector<int> sorted(size);
+        if (patience_sort_copy(example.cbegin(), example.cend(), sorted.begin()) != sorted.end())
+            return false;
+        if (example != original || !std::is_sorted(sorted.begin(), sorted.end()))
+            return false;
+
+        // Source which is not const is not moved from
+        std::vector<std::string> strings(example.size());
+        std::transform(example.begin(), example.end(), strings.begin(), [](int x) { return std::to_string(x); });
+        auto copy = strings;
+        std::vector<std::string> sorted_strings;
+        patience_sort_copy(strings.begin(), strings.end(), std::back_inserter(sorted_strings));
+        if (strings != copy || !std::is_sorted(sorted_strings.begin(), sorted_strings.end()))
+            return false;
+
+        std::list<int> inverse;
+        patience_sort_copy(example.cbegin(), example.cend(), std::back_inserter(inverse), std::greater<int>());
+        if (inverse.size() != size || !std::is_sorted(inverse.rbegin(), inverse.rend()))
+            return false;
+
+        // Lists are copied from as well
+        std::vector<int> from_list(size);
+        patience_sort_copy(inverse.cbegin(), inverse.cend(), from_list.begin());
+        if (from_list != sorted)
+            return false;
+    }
+
+    return true;
+}
+
+// Counts live objects, so elements lost on an exception are found
+struct Tracked
+{
+    static std::atomic<std::ptrdiff_t> live;
+
+    explicit Tracked(int key) : key(key) { ++live; }
+    Tracked(const Tracked& rhs) : key(rhs.key) { ++live; }
+    Tracked& operator=(const Tracked&) = default;
+    ~Tracked() { --live; }
+
+    int key;
+};
+
+std::atomic<std::ptrdiff_t> Tracked::live = 0;
+
+// Comparisons throw at every stage of the sort, and elements are destroyed with the input
+template<typename Container, typename Sort>
+static bool check_throwing_with(Sort sort)
+{
+    for (std::size_t limit = 1;; limit = limit * 3 / 2 + 1) {
+        bool thrown = false;
+        {
+            Container example;
+            for (int x : random_vector(2000))
+                example.emplace_back(x);
+            std::atomic<std::size_t> comparisons = 0;
+            auto cmp = [&](const Tracked& a, const Tracked& b) {
+                if (++comparisons == limit)
+                    throw std::runtime_error("comparison");
+                return a.key < b.key;
+            };
+            try {
+                sort(example, cmp);
+            }
+            catch (const std::runtime_error&) {
+                thrown = true;
+            }
+        }
+        if (Tracked::live != 0)
+            return false;
+        if (!thrown)
+            return true;
+    }
+}
+
+static bool check_throwing()
+{
+    return check_throwing_with<std::vector<Tracked>>([](auto& example, auto cmp) { patience_sort_cont(example.begin(), example.end(), cmp); })
+        && check_throwing_with<std::vector<Tracked>>([](auto& example, auto cmp) { patience_sort_arena(example.begin(), example.end(), cmp); })
+        && check_throwing_with<std::list<Tracked>>([](auto& example, auto cmp) { patience_sort_cont(example.begin(), example.end(), cmp); })
+        && check_throwing_with<std::vector<Tracked>>([](auto& example, auto cmp) {
+               std::vector<Tracked> sorted;
+               patience_sort_copy(example.cbegin(), example.cend(), std::back_inserter(sorted), cmp);
+           })
+        && check_throwing_with<std::vector<Tracked>>([](auto& example, auto cmp) {
+               Patience::WorkStealingPool pool(4);
+               patience_sort_tasks(example.begin(), example.end(), cmp, pool);
+           });
+}
+
+// Every number of decks up to 9, so both parities of merge rounds are taken
+static bool check_ping_pong()
+{
+    for (std::size_t decks = 1; decks <= 9; ++decks) {
+        std::vector<std::string> example;
+        for (std::size_t i = 0; i < 100; ++i)
+            example.push_back(std::to_string(1000 + i % decks * 100 + i));
+        auto arena = example;
+        patience_sort_cont(example.begin(), example.end());
+        patience_sort_arena(arena.begin(), arena.end());
+        if (!std::is_sorted(example.begin(), example.end()) || example != arena)
+            return false;
+    }
+
+    return true;
+}
+
+static bool check_kway()
+{
+    for (std::size_t size : {0, 1, 2, 3, 10, 10000}) {
+        auto example = random_vector(size);
+        patience_sort_kway(example.begin(), example.end(), compare);
+        if (!std::is_sorted(example.begin(), example.end(), compare))
+            return false;
+    }
+
+    // Equal keys keep their order
+    std::vector<std::pair<int, int>> pairs;
+    for (int x : random_vector(3000))
+        pairs.emplace_back(x % 50, pairs.size());
+    patience_sort_kway(pairs.begin(), pairs.end(), [](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; });
+    return std::is_sorted(pairs.begin(), pairs.end());
+}
+
+static bool check_plan()
+{
+    // Small ranges are merged together before the large one
+    std::vector<std::size_t> bounds = {0, 1000, 1001, 1002, 1003, 1004};
+    auto steps = Patience::plan_merges(bounds);
+    std::size_t moved = 0;
+    for (const auto& step : steps)
+        moved += step.last - step.first;
+    if (steps.size() != 4 || steps.back().middle != 1000 || moved != 1004 + 4 + 2 + 2)
+        return false;
+
+    for (std::size_t decks : {1, 2, 3, 7, 100}) {
+        bounds.assign(1, 0);
+        for (std::size_t i = 0; i < decks; ++i)
+            bounds.push_back(bounds.back() + 1 + i * 37 % 11);
+        auto plan = Patience::plan_merges(bounds);
+        if (plan.size() != decks - 1 || (decks > 1 && (plan.back().first != 0 || plan.back().last != bounds.back())))
+            return false;
+    }
+
+    return true;
+}
+
+// Runs which do not overlap or overlap a little are merged with few comparisons
+static bool check_gallop()
+{
+    std::size_t comparisons = 0;
+    auto counting = [&comparisons](const std::string& lhs, const std::string& rhs) {
+        ++comparisons;
+        return lhs < rhs;
+    };
+
+    std::vector<std::string> example;
+    for (int i = 0; i < 2000; ++i)
+        example.push_back(std::to_string(10000 + (i + 1000) % 2000 * 2));
+    example.push_back("11001");
+    std::list<std::string> list(example.begin(), example.end());
+
+    // Dealing takes about 2 comparisons per element, and merging is nearly free
+    patience_sort_cont(example.begin(), example.end(), counting);
+    if (comparisons > example.size() * 7 / 4 || !std::is_sorted(example.begin(), example.end()))
+        return false;
+
+    // Bidirectional iterators take the path which merges in place with scratch
+    patience_sort_cont(list.begin(), list.end(), counting);
+    if (!std::is_sorted(list.begin(), list.end()))
+        return false;
+
+    list.assign(example.rbegin(), example.rend());
+    patience_sort(list, counting);
+    return std::is_sorted(list.begin(), list.end());
+}
+
+static bool check_branchless()
+{
+    for (std::size_t size : {1, 7, 8, 9, 100, 3000}) {
+        for (std::size_t spread : {1, 16, 1000000}) {
+            std::vector<int> a, b;
+            for (int x : random_vector(size))
+                (x % spread == 0 ? b : a).push_back(x);
+            std::sort(a.begin(), a.end());
+            std::sort(b.begin(), b.end());
+            std::vector<int> expected, merged(a.size() + b.size());
+            std::merge(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(expected));
+            auto [a_end, b_end, out] = Patience::branchless_merge(a.begin(), a.end(), b.begin(), b.end(), merged.begin(), std::less<int>());
+            std::copy(b_end, b.end(), std::copy(a_end, a.end(), out));
+            if (merged != expected)
+                return false;
+        }
+    }
+
+    auto example = random_vector(3000);
+    std::vector<double> doubles(example.begin(), example.end());
+    patience_sort_cont(example.begin(), example.end(), std::greater<int>());
+    patience_sort_scatter(doubles.begin(), doubles.end());
+    return std::is_sorted(example.rbegin(), example.rend()) && std::is_sorted(doubles.begin(), doubles.end());
+}
+
+// Vector kernel is used for contiguous 32 and 64-bit keys, including merges into the place of the second range
+template<typename T, typename Compare>
+static bool check_bitonic_merge(Compare cmp)
+{
+    for (std::size_t size : {0, 5, 16, 31, 33, 100, 3000}) {
+        for (int spread : {1, 3, 1000000}) {
+            std::vector<T> a, b;
+            for (int x : random_vector(size))
+                (x % spread == 0 ? b : a).push_back(T(x % 1000));
+            std::sort(a.begin(), a.end(), cmp);
+            std::sort(b.begin(), b.end(), cmp);
+            std::vector<T> expected, merged(a.size() + b.size());
+            std::merge(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(expected), cmp);
+            std::copy(b.begin(), b.end(), merged.begin() + a.size());
+            auto [a_end, b_end, out] = Patience::merge_kernel(a.data(), a.data() + a.size(),
+                merged.data() + a.size(), merged.data() + merged.size(), merged.data(), cmp);
+            std::copy(a_end, a.data() + a.size(), out);
+            if (b_end != merged.data() + merged.size() && b_end != out)
+                return false;
+            if (merged != expected)
+                return false;
+        }
+    }
+    return true;
+}
+
+// Negative and positive zeros are equal, but each of them must stay in the output
+template<typename T, typename Compare>
+static bool check_signed_zeros(Compare cmp)
+{
+    std::vector<T> example;
+    for (int x : random_vector(4000))
+        example.push_back(x % 6 == 0 ? T(-0.0) : x % 6 == 1 ? T(0.0) : T(x % 100 - 50));
+    auto negative = std::count_if(example.begin(), example.end(), [](T x) { return x == 0 && std::signbit(x); });
+    auto scattered = example;
+    patience_sort_scatter(scattered.begin(), scattered.end(), cmp);
+    patience_sort_cont(example.begin(), example.end(), cmp);
+    for (const auto& sorted : {scattered, example})
+        if (!std::is_sorted(sorted.begin(), sorted.end(), cmp)
+            || std::count_if(sorted.begin(), sorted.end(), [](T x) { return x == 0 && std::signbit(x); }) != negative)
+            return false;
+    return true;
+}
+
+static bool check_bitonic()
+{
+    if (!check_signed_zeros<float>(std::less<float>()) || !check_signed_zeros<double>(std::greater<double>()))
+        return false;
+
+    auto example = random_vector(3000);
+    std::vector<long long> longs(example.begin(), example.end());
+    std::vector<float> floats(example.begin(), example.end());
+    patience_sort_cont(longs.begin(), longs.end(), std::greater<long long>());
+    patience_sort_scatter(floats.begin(), floats.end());
+    return check_bitonic_merge<int>(std::less<int>()) && check_bitonic_merge<int>(std::greater<int>())
+        && check_bitonic_merge<long long>(std::less<long long>()) && check_bitonic_merge<float>(std::greater<float>())
+        && check_bitonic_merge<double>(std::less<double>())
+        && std::is_sorted(longs.rbegin(), longs.rend()) && std::is_sorted(floats.begin(), floats.end());
+}
+
+static bool check_parallel()
+{
+    Patience::ThreadPool pool(4);
+    for (std::size_t size : {0, 1, 2, 3, 10, 10000, 100000}) {
+        auto example = random_vector(size);
+        patience_sort_parallel(example.begin(), example.end(), compare, pool);
+        if (!std::is_sorted(example.begin(), example.end(), compare))
+            return false;
+    }
+
+    // Equal keys keep their order
+    std::vector<std::pair<int, int>> pairs;
+    for (int x : random_vector(30000))
+        pairs.emplace_back(x % 50, pairs.size());
+    patience_sort_parallel(pairs.begin(), pairs.end(), [](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; }, pool);
+    if (!std::is_sorted(pairs.begin(), pairs.end()))
+        return false;
+
+    // Chunks are dealt simultaneously from a resource which is not thread-safe,
+    // and no other memory is allocated
+    std::vector<std::byte> memory(1 << 22);
+    std::pmr::monotonic_buffer_resource resource(memory.data(), memory.size(), std::pmr::null_memory_resource());
+    auto example = random_vector(50000);
+    std::size_t allocations = heap_allocations;
+    Patience::sort_parallel(example.begin(), example.end(), compare, pool, &resource);
+    if (heap_allocations != allocations || !std::is_sorted(example.begin(), example.end(), compare))
+        return false;
+
+    // Each task runs once, and the pool is usable after a task throws
+    std::vector<int> counts(1000);
+    pool.for_each(counts.size(), [&](std::size_t i) { ++counts[i]; });
+    try {
+        pool.for_each(100, [](std::size_t i) { if (i == 50) throw std::runtime_error("task"); });
+        return false;
+    }
+    catch (const std::runtime_error&) { }
+    pool.for_each(counts.size(), [&](std::size_t i) { ++counts[i]; });
+    return std::all_of(counts.begin(), counts.end(), [](int count) { return count == 2; });
+}
+
+// Segments of the merge path put equal keys of the first range first
+static bool check_merge_path()
+{
+    using Pair = std::pair<int, int>;
+    auto by_key = [](const Pair& lhs, const Pair& rhs) { return lhs.first < rhs.first; };
+    for (std::size_t size : {1, 2, 10, 1000}) {
+        std::vector<Pair> input;
+        for (int x : random_vector(size))
+            input.emplace_back(x % 7, input.size());
+        auto middle = input.begin() + size / 3;
+        std::sort(input.begin(), middle);
+        std::sort(middle, input.end());
+        std::vector<Pair> expected;
+        std::merge(input.begin(), middle, middle, input.end(), std::back_inserter(expected), by_key);
+        for (std::size_t segments : {1, 2, 3, 16, 1000}) {
+            std::vector<Pair> merged(size);
+            std::vector<Patience::MergeSegment> parts;
+            Patience::split_merge(input.begin(), 0, size / 3, size, segments, by_key, parts);
+            for (const auto& part : parts)
+                Patience::merge_segment(input.begin(), merged.begin(), part, by_key);
+            if (merged != expected)
+                return false;
+        }
+    }
+    return true;
+}
+
+// Runs tasks of each round on the calling thread in reverse order
+struct ReverseExecutor
+{
+    std::size_t size() const noexcept { return 4; }
+
+    template<typename F>
+    void for_each(std::size_t count, F f)
+    {
+        ++rounds;
+        for (std::size_t i = count; i != 0; --i)
+            f(i - 1);
+    }
+
+    std::size_t rounds = 0;
+};
+
+static bool check_executor()
+{
+    ReverseExecutor executor;
+    auto example = random_vector(100000);
+    patience_sort_parallel(example.begin(), example.end(), compare, executor);
+    if (!std::is_sorted(example.begin(), example.end(), compare) || executor.rounds < 2)
+        return false;
+
+#ifdef __cpp_lib_execution
+    for (std::size_t size : {0, 1, 10000}) {
+        auto sequenced = random_vector(size);
+        auto parallel = sequenced;
+        patience_sort(std::execution::seq, sequenced.begin(), sequenced.end(), compare);
+        patience_sort(std::execution::par, parallel.begin(), parallel.end());
+        if (!std::is_sorted(sequenced.begin(), sequenced.end(), compare) || !std::is_sorted(parallel.begin(), parallel.end()))
+            return false;
+    }
+#endif
+    return true;
+}
+
+static bool check_tasks()
+{
+    Patience::WorkStealingPool pool(4);
+    for (std::size_t size : {0, 1, 2, 3, 10, 10000, 100000}) {
+        auto example = random_vector(size);
+        patience_sort_tasks(example.begin(), example.end(), compare, pool);
+        if (!std::is_sorted(example.begin(), example.end(), compare))
+            return false;
+    }
+
+    // A long sorted run and many short decks, equal keys keep their order
+    std::vector<std::pair<std::string, int>> pairs;
+    for (int x : random_vector(60000))
+        pairs.emplace_back(std::to_string(pairs.size() < 40000 ? pairs.size() / 8 : x % 5000), pairs.size());
+    patience_sort_tasks(pairs.begin(), pairs.end(), [](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; }, pool);
+    for (std::size_t i = 1; i < pairs.size(); ++i)
+        if (pairs[i].first < pairs[i - 1].first || (pairs[i].first == pairs[i - 1].first && pairs[i].second < pairs[i - 1].second))
+            return false;
+
+    // Merges split into segments simultaneously from a resource which is not thread-safe
+    std::pmr::monotonic_buffer_resource resource;
+    auto example = random_vector(100000);
+    Patience::sort_tasks(example.begin(), example.end(), compare, pool, &resource);
+    if (!std::is_sorted(example.begin(), example.end(), compare))
+        return false;
+
+    // Tasks spawn tasks, and all of them finish before run returns
+    std::atomic<int> leaves = 0;
+    std::function<void(int)> split = [&](int depth) {
+        if (depth == 0)
+            ++leaves;
+        else
+            for (int i = 0; i < 2; ++i)
+                pool.spawn([&split, depth] { split(depth - 1); });
+    };
+    pool.run([&] { split(10); });
+    try {
+        pool.run([] { throw std::runtime_error("task"); });
+        return false;
+    }
+    catch (const std::runtime_error&) { }
+    return leaves == 1024;
+}
+
+// Runs rounds on the calling thread, the task running is known to comparators
+struct SerialExecutor
+{
+    std::size_t size() const noexcept { return 4; }
+
+    template<typename F>
+    void for_each(std::size_t count, F f)
+    {
+        comparisons.assign(count, 0);
+        for (task = 0; task < count; ++task)
+            f(task);
+    }
+
+    std::size_t task = 0;
+    std::vector<std::size_t> comparisons; // by tasks of the last round
+};
+
+static bool check_buckets()
+{
+    Patience::ThreadPool pool(4);
+    for (std::size_t size : {0, 1, 10, 4095, 40000, 100000}) {
+        auto example = random_vector(size);
+        patience_sort_buckets(example.begin(), example.end(), compare, pool);
+        if (!std::is_sorted(example.begin(), example.end(), compare))
+            return false;
+    }
+
+    // Few distinct keys make equal splitters, equal keys keep their order
+    std::vector<std::pair<std::string, int>> pairs;
+    for (int x : random_vector(50000))
+        pairs.emplace_back(std::to_string(x % 3), pairs.size());
+    patience_sort_buckets(pairs.begin(), pairs.end(), [](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; }, pool);
+    if (!std::is_sorted(pairs.begin(), pairs.end()))
+        return false;
+
+    // Input repeating with the stride of evenly spaced samples still makes buckets of similar cost
+    SerialExecutor executor;
+    std::vector<int> periodic(1 << 16);
+    for (std::size_t i = 0; i < periodic.size(); ++i)
+        periodic[i] = i % 1024;
+    patience_sort_buckets(periodic.begin(), periodic.end(), [&](int lhs, int rhs) {
+        if (executor.task < executor.comparisons.size())
+            ++executor.comparisons[executor.task];
+        return lhs < rhs;
+    }, executor);
+    auto [min, max] = std::minmax_element(executor.comparisons.begin(), executor.comparisons.end());
+    return std::is_sorted(periodic.begin(), periodic.end()) && executor.comparisons.size() == 4 && *max <= 2 * *min;
+}
+
 int main()
 {
-    for (auto f : {check_cont, check_list, check_list_inplace, check_inverse}) {
+    for (auto f : {check_cont, check_list, check_list_inplace, check_inverse,
+                   check_pmr_list, check_many_decks, check_eytzinger, check_vector_keys,
+                   check_move_only, check_runs, check_adaptive, check_arena,
+                   check_scatter, check_sorter, check_resource,
+                   check_projection, check_argsort,
+                   check_indirect, check_planned, check_copy,
+                   check_throwing, check_ping_pong, check_kway,
+                   check_plan, check_gallop,
+                   check_branchless, check_bitonic,
+                   check_parallel, check_merge_path,
+                   check_executor, check_tasks,
+                   check_buckets}) {
         bool result = f();
         if (!result) {
             std::cout << "Failure\n";